@@ -0,0 +1,386 @@
+// Copyright (C) 2014 Igor Kaplounenko
+// Licensed under MIT License
+
+// Encode/decode throughput over a representative corpus: KRPC queries and
+// responses, compact peer lists, and a small and a huge .torrent. Reports
+// ns/op, messages/s, MB/s and heap allocations per op for every case.
+
+#include "ebb.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace ebb;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+	allocations++;
+	void* p = std::malloc(size ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+// sink for results so that the benchmarked work is not optimized away
+static volatile size_t checksum = 0;
+
+// runs f for at least min_seconds and prints per-op statistics; bytes is the
+// size of one message
+template<typename F> static void run(const char* name, size_t bytes, F f) {
+	const double min_seconds = 0.25;
+	f();
+	for (size_t iterations = 1;; iterations *= 2) {
+		size_t allocations_before = allocations;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; i++) {
+			f();
+		}
+		double seconds = std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start).count();
+		if (seconds < min_seconds) {
+			continue;
+		}
+		double per_op = seconds / iterations;
+		std::printf("%-42s %12.1f ns/op %12.0f msg/s %10.1f MB/s %8.2f allocs/op\n",
+				name, per_op * 1e9, 1 / per_op, bytes / per_op / 1e6,
+				double(allocations - allocations_before) / iterations);
+		return;
+	}
+}
+
+typedef std::array<unsigned char, 20> node_id;
+typedef std::array<unsigned char, 6> compact_peer;
+typedef std::array<unsigned char, 26> compact_node;
+
+struct find_node_args {
+	node_id id;
+	node_id target;
+};
+EBB_FIELDS(find_node_args, id, target)
+
+struct find_node_query {
+	find_node_args a;
+	std::string q;
+	bstring_view t;
+	bstring_view y;
+};
+EBB_FIELDS(find_node_query, a, q, t, y)
+
+static node_id make_id(unsigned seed) {
+	node_id id;
+	for (size_t i = 0; i < id.size(); i++) {
+		id[i] = static_cast<unsigned char>(seed * 131 + i * 7);
+	}
+	return id;
+}
+
+static void decode(const char* name, std::vector<unsigned char> const& message) {
+	std::vector<btoken> tokens(message.size() / 2 + 16);
+	run(name, message.size(), [&]() {
+		bdecoder decoder(tokens.data(), tokens.size());
+		checksum += decoder(message.data(), message.size()) != NULL;
+		checksum += decoder.size();
+	});
+}
+
+static void validate(const char* name, std::vector<unsigned char> const& message) {
+	std::vector<btoken> tokens(message.size() / 2 + 16);
+	run(name, message.size(), [&]() {
+		bdecoder decoder(tokens.data(), tokens.size());
+		checksum += decoder.canonical(message.data(), message.size()) != NULL;
+		checksum += decoder.size();
+	});
+}
+
+// counts events so the parser's work can't be optimized away
+struct counting_visitor {
+	size_t events;
+
+	void begin_dict() { events++; }
+	void begin_list() { events++; }
+	void end() { events++; }
+	void integer(std::int64_t value) { events += value & 1; }
+	void key(const unsigned char*, size_t size, size_t) { events += size; }
+	void string(const unsigned char*, size_t size, size_t) { events += size; }
+};
+
+// feeds the message to bparser in TCP segment sized chunks
+static void stream_parse(const char* name, std::vector<unsigned char> const& message) {
+	run(name, message.size(), [&]() {
+		counting_visitor visitor = {0};
+		bparser<counting_visitor> parser(visitor);
+		for (size_t at = 0; at < message.size(); at += 1460) {
+			parser.feed(message.data() + at, std::min<size_t>(1460, message.size() - at));
+		}
+		checksum += visitor.events + parser.done();
+	});
+}
+
+static void krpc() {
+	std::vector<unsigned char> buffer(4096);
+	node_id id = make_id(1);
+	node_id target = make_id(2);
+	std::array<unsigned char, 2> t = {{'a', 'a'}};
+
+	run("encode ping query", 56, [&]() {
+		unsigned char* last = bencoder(buffer.data(), buffer.size())(
+				bdict(
+					k_v("a", bdict(k_v("id", id))),
+					k_v("q", "ping"),
+					k_v("t", t),
+					k_v("y", "q")
+					)
+				);
+		checksum += last - buffer.data();
+	});
+
+	bslot<20> id_slot;
+	bslot<2> t_slot;
+	btemplate<64> ping;
+	ping.compile(
+			bdict(
+				k_v("a", bdict(k_v("id", id_slot))),
+				k_v("q", "ping"),
+				k_v("t", t_slot),
+				k_v("y", "q")
+				)
+			);
+	run("encode ping query (btemplate)", ping.size(), [&]() {
+		unsigned char* last = ping(buffer.data(), buffer.size());
+		id_slot.patch(buffer.data(), id);
+		t_slot.patch(buffer.data(), t);
+		checksum += last - buffer.data();
+	});
+
+	unsigned char* last = bencoder(buffer.data(), buffer.size())(
+			bdict(
+				k_v("a", bdict(k_v("id", id), k_v("target", target))),
+				k_v("q", "find_node"),
+				k_v("t", t),
+				k_v("y", "q")
+				)
+			);
+	std::vector<unsigned char> query(buffer.data(), last);
+	decode("decode find_node query", query);
+	std::vector<btoken> tokens(16);
+	find_node_query decoded;
+	run("decode find_node query into struct", query.size(), [&]() {
+		bdecoder decoder(tokens.data(), tokens.size());
+		checksum += decoder(query.data(), query.size()) != NULL
+			&& bdecode(decoder.root(), decoded);
+		checksum += decoded.a.target[0];
+	});
+	run("encode find_node query from struct", query.size(), [&]() {
+		unsigned char* last = bencoder(buffer.data(), buffer.size())(decoded);
+		checksum += last - buffer.data();
+	});
+
+	std::array<unsigned char, 8 * 26> nodes;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		nodes[i] = static_cast<unsigned char>(i);
+	}
+	run("encode find_node response", bencoded_size(
+				bdict(k_v("r", bdict(k_v("id", id), k_v("nodes", nodes))),
+					k_v("t", t), k_v("y", "r"))), [&]() {
+		unsigned char* last = bencoder(buffer.data(), buffer.size())(
+				bdict(
+					k_v("r", bdict(k_v("id", id), k_v("nodes", nodes))),
+					k_v("t", t),
+					k_v("y", "r")
+					)
+				);
+		checksum += last - buffer.data();
+	});
+
+	std::vector<compact_peer> peers(50);
+	for (size_t i = 0; i < peers.size(); i++) {
+		peers[i].fill(static_cast<unsigned char>(i));
+	}
+	std::array<unsigned char, 8> token = {{'t', 'o', 'k', 'e', 'n', '0', '0', '1'}};
+	size_t get_peers_size = bencoded_size(
+			bdict(
+				k_v("r", bdict(k_v("id", id), k_v("token", token), k_v("values", peers))),
+				k_v("t", t),
+				k_v("y", "r")
+				)
+			);
+	run("encode get_peers response (50 peers)", get_peers_size, [&]() {
+		unsigned char* last = bencoder(buffer.data(), buffer.size())(
+				bdict(
+					k_v("r", bdict(k_v("id", id), k_v("token", token), k_v("values", peers))),
+					k_v("t", t),
+					k_v("y", "r")
+					)
+				);
+		checksum += last - buffer.data();
+	});
+	last = bencoder(buffer.data(), buffer.size())(
+			bdict(
+				k_v("r", bdict(k_v("id", id), k_v("token", token), k_v("values", peers))),
+				k_v("t", t),
+				k_v("y", "r")
+				)
+			);
+	std::vector<unsigned char> response(buffer.data(), last);
+	decode("decode get_peers response (50 peers)", response);
+	stream_parse("stream-parse get_peers response (50 peers)", response);
+}
+
+// find_node response i of a burst, differing in transaction ID
+struct find_node_responses {
+	node_id const& id;
+	std::array<unsigned char, 8 * 26> const& nodes;
+
+	template<typename Encode> bool operator()(size_t i, Encode& encode) const {
+		return encode(bdict(
+					k_v("r", bdict(k_v("id", id), k_v("nodes", nodes))),
+					k_v("t", static_cast<std::int64_t>(i)),
+					k_v("y", "r")));
+	}
+};
+
+static void batches() {
+	const size_t n = 4096;
+	node_id id = make_id(1);
+	std::array<unsigned char, 8 * 26> nodes;
+	nodes.fill('n');
+	find_node_responses generate = {id, nodes};
+	std::vector<unsigned char> buffer(n * 512);
+	std::vector<bslice> slices(n);
+	bbatch sizing(buffer.data(), buffer.size(), slices.data(), slices.size());
+	sizing.append(n, generate);
+	const size_t bytes = sizing.bytes();
+
+	run("batch-encode 4096 find_node responses", bytes, [&]() {
+		bbatch batch(buffer.data(), buffer.size(), slices.data(), slices.size());
+		checksum += batch.append(n, generate) + batch.bytes();
+	});
+	// sizes every message, then encodes on up to 4 cores
+	const size_t workers = std::min(4u, std::thread::hardware_concurrency());
+	run("batch-encode 4096 in parallel", bytes, [&]() {
+		bbatch batch(buffer.data(), buffer.size(), slices.data(), slices.size());
+		checksum += batch.append_parallel(n, generate, workers) + batch.bytes();
+	});
+}
+
+struct torrent_file {
+	std::int64_t length;
+	std::vector<std::string> path;
+};
+EBB_FIELDS(torrent_file, length, path)
+
+// info dict of a multi-file torrent with one list entry per file
+static std::vector<unsigned char> make_torrent(size_t files, size_t pieces) {
+	std::vector<torrent_file> file_list(files);
+	for (size_t i = 0; i < files; i++) {
+		file_list[i].length = std::int64_t(16384 * (i + 1));
+		file_list[i].path = {"directory", "file" + std::to_string(i) + ".bin"};
+	}
+	std::vector<unsigned char> piece_hashes(pieces * 20, 'p');
+	std::vector<unsigned char> output(files * 64 + pieces * 20 + 1024);
+	unsigned char* last = bencoder(output.data(), output.size())(
+			bdict(
+				k_v("announce", "http://tracker.example.com:6969/announce"),
+				k_v("info", bdict(
+						k_v("files", file_list),
+						k_v("name", "example"),
+						k_v("piece length", 262144),
+						k_v("pieces", piece_hashes)
+						))
+				)
+			);
+	output.resize(last ? last - output.data() : 0);
+	return output;
+}
+
+static void torrents() {
+	std::vector<unsigned char> pieces(100 * 20, 'p');
+	std::vector<unsigned char> buffer(64 * 1024);
+	size_t small_size = bencoded_size(
+			bdict(
+				k_v("announce", "http://tracker.example.com:6969/announce"),
+				k_v("info", bdict(
+						k_v("length", 26214400),
+						k_v("name", "example.bin"),
+						k_v("piece length", 262144),
+						k_v("pieces", pieces)
+						))
+				)
+			);
+	run("encode small .torrent", small_size, [&]() {
+		unsigned char* last = bencoder(buffer.data(), buffer.size())(
+				bdict(
+					k_v("announce", "http://tracker.example.com:6969/announce"),
+					k_v("info", bdict(
+							k_v("length", 26214400),
+							k_v("name", "example.bin"),
+							k_v("piece length", 262144),
+							k_v("pieces", pieces)
+							))
+					)
+				);
+		checksum += last - buffer.data();
+	});
+	run("encode small .torrent + info-hash", small_size, [&]() {
+		sha1 info_hash;
+		unsigned char* last = bencoder(buffer.data(), buffer.size())(
+				bdict(
+					k_v("announce", "http://tracker.example.com:6969/announce"),
+					k_v("info", bhashed(info_hash, bdict(
+							k_v("length", 26214400),
+							k_v("name", "example.bin"),
+							k_v("piece length", 262144),
+							k_v("pieces", pieces)
+							)))
+					)
+				);
+		checksum += last - buffer.data() + info_hash.final()[0];
+	});
+	std::vector<unsigned char> small = make_torrent(1, 100);
+	decode("decode small .torrent", small);
+	validate("validate canonical small .torrent", small);
+
+	std::vector<btoken> tokens(64);
+	std::vector<unsigned char> pool(16 * 1024);
+	run("rewrite small .torrent (bvalue)", small.size(), [&]() {
+		// one arena per document, reset instead of freeing node by node
+		barena arena(pool.data(), pool.size());
+		bdecoder decoder(tokens.data(), tokens.size());
+		bvalue root;
+		if (!decoder(small.data(), small.size()) || !root.load(arena, decoder.root())) {
+			return;
+		}
+		root.set(arena, "announce", bvalue("http://other.example.com/announce"));
+		root.find("info")->set(arena, "private", bvalue(std::int64_t(1)));
+		unsigned char* last = bencoder(buffer.data(), buffer.size())(root);
+		checksum += last - buffer.data();
+	});
+
+	std::vector<unsigned char> huge = make_torrent(20000, 200000);
+	decode("decode huge .torrent (20k files)", huge);
+	validate("validate canonical huge .torrent", huge);
+	stream_parse("stream-parse huge .torrent (20k files)", huge);
+	run("lazy name + piece hash of huge .torrent", huge.size(), [&]() {
+		btorrent torrent(huge.data(), huge.size());
+		checksum += torrent.name().size() + torrent.piece(123456)[0];
+	});
+}
+
+int main() {
+	krpc();
+	batches();
+	torrents();
+	return checksum == 0;
+}
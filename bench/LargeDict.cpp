@@ -0,0 +1,145 @@
+// Copyright (C) 2014 Igor Kaplounenko
+// Licensed under MIT License
+
+// A single bdict expression with 128 entries, built by compile_stats.sh to
+// track the compile time and code size that large messages cost.
+
+#include "ebb.hpp"
+
+using namespace ebb;
+
+unsigned char* encode_large_dict(unsigned char* buffer, size_t len, int i,
+		std::array<unsigned char, 20> const& id) {
+	return bencoder(buffer, len)(
+			bdict(
+				k_v("key000", i),
+				k_v("key001", "value001"),
+				k_v("key002", id),
+				k_v("key003", i),
+				k_v("key004", "value004"),
+				k_v("key005", id),
+				k_v("key006", i),
+				k_v("key007", "value007"),
+				k_v("key008", id),
+				k_v("key009", i),
+				k_v("key010", "value010"),
+				k_v("key011", id),
+				k_v("key012", i),
+				k_v("key013", "value013"),
+				k_v("key014", id),
+				k_v("key015", i),
+				k_v("key016", "value016"),
+				k_v("key017", id),
+				k_v("key018", i),
+				k_v("key019", "value019"),
+				k_v("key020", id),
+				k_v("key021", i),
+				k_v("key022", "value022"),
+				k_v("key023", id),
+				k_v("key024", i),
+				k_v("key025", "value025"),
+				k_v("key026", id),
+				k_v("key027", i),
+				k_v("key028", "value028"),
+				k_v("key029", id),
+				k_v("key030", i),
+				k_v("key031", "value031"),
+				k_v("key032", id),
+				k_v("key033", i),
+				k_v("key034", "value034"),
+				k_v("key035", id),
+				k_v("key036", i),
+				k_v("key037", "value037"),
+				k_v("key038", id),
+				k_v("key039", i),
+				k_v("key040", "value040"),
+				k_v("key041", id),
+				k_v("key042", i),
+				k_v("key043", "value043"),
+				k_v("key044", id),
+				k_v("key045", i),
+				k_v("key046", "value046"),
+				k_v("key047", id),
+				k_v("key048", i),
+				k_v("key049", "value049"),
+				k_v("key050", id),
+				k_v("key051", i),
+				k_v("key052", "value052"),
+				k_v("key053", id),
+				k_v("key054", i),
+				k_v("key055", "value055"),
+				k_v("key056", id),
+				k_v("key057", i),
+				k_v("key058", "value058"),
+				k_v("key059", id),
+				k_v("key060", i),
+				k_v("key061", "value061"),
+				k_v("key062", id),
+				k_v("key063", i),
+				k_v("key064", "value064"),
+				k_v("key065", id),
+				k_v("key066", i),
+				k_v("key067", "value067"),
+				k_v("key068", id),
+				k_v("key069", i),
+				k_v("key070", "value070"),
+				k_v("key071", id),
+				k_v("key072", i),
+				k_v("key073", "value073"),
+				k_v("key074", id),
+				k_v("key075", i),
+				k_v("key076", "value076"),
+				k_v("key077", id),
+				k_v("key078", i),
+				k_v("key079", "value079"),
+				k_v("key080", id),
+				k_v("key081", i),
+				k_v("key082", "value082"),
+				k_v("key083", id),
+				k_v("key084", i),
+				k_v("key085", "value085"),
+				k_v("key086", id),
+				k_v("key087", i),
+				k_v("key088", "value088"),
+				k_v("key089", id),
+				k_v("key090", i),
+				k_v("key091", "value091"),
+				k_v("key092", id),
+				k_v("key093", i),
+				k_v("key094", "value094"),
+				k_v("key095", id),
+				k_v("key096", i),
+				k_v("key097", "value097"),
+				k_v("key098", id),
+				k_v("key099", i),
+				k_v("key100", "value100"),
+				k_v("key101", id),
+				k_v("key102", i),
+				k_v("key103", "value103"),
+				k_v("key104", id),
+				k_v("key105", i),
+				k_v("key106", "value106"),
+				k_v("key107", id),
+				k_v("key108", i),
+				k_v("key109", "value109"),
+				k_v("key110", id),
+				k_v("key111", i),
+				k_v("key112", "value112"),
+				k_v("key113", id),
+				k_v("key114", i),
+				k_v("key115", "value115"),
+				k_v("key116", id),
+				k_v("key117", i),
+				k_v("key118", "value118"),
+				k_v("key119", id),
+				k_v("key120", i),
+				k_v("key121", "value121"),
+				k_v("key122", id),
+				k_v("key123", i),
+				k_v("key124", "value124"),
+				k_v("key125", id),
+				k_v("key126", i),
+				k_v("key127", "value127")
+				)
+			);
+}
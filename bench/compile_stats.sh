@@ -0,0 +1,18 @@
+#!/bin/sh
+# Reports the compile time and object size of bench/LargeDict.cpp, a single
+# bdict expression with 128 entries, at the optimization levels of interest.
+# Usage: bench/compile_stats.sh [compiler] (defaults to $CXX, then c++)
+
+CXX=${1:-${CXX:-c++}}
+cd "$(dirname "$0")/.." || exit 1
+out=$(mktemp -d) || exit 1
+trap 'rm -rf "$out"' EXIT
+
+for level in -O0 -Os -O2; do
+	start=$(date +%s.%N)
+	"$CXX" -std=c++11 $level -I. -c bench/LargeDict.cpp -o "$out/LargeDict.o" || exit 1
+	end=$(date +%s.%N)
+	size=$(size "$out/LargeDict.o" | awk 'NR == 2 { print $1 }')
+	awk -v level="$level" -v start="$start" -v end="$end" -v size="$size" \
+		'BEGIN { printf "%-4s compile %6.2f s   text %8s bytes\n", level, end - start, size }'
+done
@@ -3,31 +3,89 @@
 // Copyright (C) 2013-2014 Igor Kaplounenko
 // Licensed under MIT License
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
-#include <cinttypes>
+#include <cerrno>
 #include <cstdint>
-#include <cstdio>
 #include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
 #include <string>
+#include <thread>
 #include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
-
-#ifndef PRId64
-#if defined MSC_VER || defined __MINGW32_
-#define PRId64 "I64d"
-#else
-#define PRId64 "lld"
+#if __cplusplus >= 201703L
+#include <optional>
 #endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #endif
 
 namespace ebb {
+	// non-owning view of a byte string such as a decoded string
+	class bstring_view {
+		private:
+			const unsigned char* ptr;
+			size_t len;
+		public:
+			bstring_view() : ptr(NULL), len(0) {};
+			bstring_view(const unsigned char* data, size_t size) : ptr(data),
+				len(size) {};
+			const unsigned char* data() const { return ptr; }
+			size_t size() const { return len; }
+			bool empty() const { return len == 0; }
+			const unsigned char* begin() const { return ptr; }
+			const unsigned char* end() const { return ptr + len; }
+			const unsigned char& operator[](size_t i) const { return ptr[i]; }
+			std::string str() const {
+				return std::string(reinterpret_cast<const char*>(ptr), len);
+			}
+	};
+
+	inline bool operator==(bstring_view const& a, bstring_view const& b) {
+		return a.size() == b.size() && (a.size() == 0
+				|| std::memcmp(a.data(), b.data(), a.size()) == 0);
+	}
+	inline bool operator!=(bstring_view const& a, bstring_view const& b) {
+		return !(a == b);
+	}
+	inline bool operator==(bstring_view const& a, char const* b) {
+		return a == bstring_view(reinterpret_cast<const unsigned char*>(b),
+				strlen(b));
+	}
+	inline bool operator!=(bstring_view const& a, char const* b) {
+		return !(a == b);
+	}
+
 	namespace detail {
 		// http://stackoverflow.com/questions/7858817/unpacking-a-tuple-to-call-a-matching-function-pointer?lq=1
 		template<int...> struct seq {};
-		template<int N, int... S> struct gen_seq : gen_seq<N-1, N-1, S...> {};
-		// generated sequence specialization / endpoint
-		template<int... S> struct gen_seq<0, S...> { typedef seq<S...> type; };
+		template<typename A, typename B> struct concat_seq;
+		template<int... A, int... B> struct concat_seq<seq<A...>, seq<B...>> {
+			typedef seq<A..., (int(sizeof...(A)) + B)...> type;
+		};
+		// seq<0, ..., N - 1>, built from two halves so that a sequence of N
+		// takes log N nested instantiations rather than N
+		template<int N> struct gen_seq : concat_seq<typename gen_seq<N / 2>::type,
+			typename gen_seq<N - N / 2>::type> {};
+		template<> struct gen_seq<0> { typedef seq<> type; };
+		template<> struct gen_seq<1> { typedef seq<0> type; };
+
+		template<bool...> struct bool_pack {};
+		template<bool... B> struct all_of : std::is_same<bool_pack<true, B...>,
+			bool_pack<B..., true>> {};
+		template<bool... B> struct any_of : std::integral_constant<bool,
+			!all_of<!B...>::value> {};
 
 		// for list and dict start/end tokens, i.e. 'd', 'l', 'e'
 		struct bencode_token {
@@ -44,160 +102,3333 @@ namespace ebb {
 			const std::array<unsigned char, N>> : std::true_type {};
 		template<size_t N> struct is_unsigned_char_array<
 			const std::array<unsigned char, N>&> : std::true_type {};
-		template<typename A> void assert_valid_key_type() {
-			static_assert(std::is_convertible<A, std::vector<unsigned char>>::value
+		// a dictionary key known at compile time, see EBB_KEY
+		template<char... C> struct bkey {
+			static constexpr unsigned char data[sizeof...(C) + 1] = {
+				static_cast<unsigned char>(C)..., 0};
+		};
+		template<char... C> constexpr unsigned char bkey<C...>::data[];
+
+		template<typename> struct is_bkey : std::false_type {};
+		template<char... C> struct is_bkey<bkey<C...>> : std::true_type {};
+
+		// builds bkey<C...> from the first Len of a fixed number of characters
+		const static size_t max_bkey_length = 32;
+		template<size_t N, typename Key, char... C> struct take_chars;
+		template<bool Done, size_t N, typename Key, char... C> struct take_chars_step {
+			typedef Key type;
+		};
+		template<size_t N, char... K, char H, char... T> struct take_chars_step<false,
+			N, bkey<K...>, H, T...> : take_chars<N - 1, bkey<K..., H>, T...> {};
+		template<size_t N, typename Key, char... C> struct take_chars
+			: take_chars_step<N == 0, N, Key, C...> {};
+		template<size_t Len, char... C> struct make_bkey : take_chars<Len, bkey<>, C...> {
+			static_assert(Len <= max_bkey_length,
+					"EBB_KEY only supports keys of up to 32 characters.");
+		};
+
+		template<size_t N> constexpr char char_at(const char (&s)[N], size_t i) {
+			return i < N ? s[i] : 0;
+		}
+
+		// byte-wise ordering of compile-time keys, as bencode requires
+		template<typename A, typename B> struct bkey_less : std::false_type {};
+		template<> struct bkey_less<bkey<>, bkey<>> : std::false_type {};
+		template<char... B> struct bkey_less<bkey<>, bkey<B...>>
+			: std::integral_constant<bool, sizeof...(B) != 0> {};
+		template<char A, char... AR> struct bkey_less<bkey<A, AR...>, bkey<>>
+			: std::false_type {};
+		template<char A, char... AR, char B, char... BR> struct bkey_less<
+			bkey<A, AR...>, bkey<B, BR...>> : std::conditional<A != B,
+				std::integral_constant<bool, static_cast<unsigned char>(A)
+					< static_cast<unsigned char>(B)>,
+				bkey_less<bkey<AR...>, bkey<BR...>>>::type {};
+
+		// true if the compile-time keys among Keys are strictly ascending; keys
+		// only known at runtime are skipped over
+		template<typename... Keys> struct static_keys_ascending : std::true_type {};
+		template<typename K1, typename K2, typename... Rest> struct static_keys_ascending<
+			K1, K2, Rest...> : std::conditional<!is_bkey<K1>::value,
+				static_keys_ascending<K2, Rest...>,
+				typename std::conditional<!is_bkey<K2>::value,
+					static_keys_ascending<K1, Rest...>,
+					typename std::conditional<bkey_less<K1, K2>::value,
+						static_keys_ascending<K2, Rest...>,
+						std::false_type>::type>::type>::type {};
+
+		template<typename A, typename B> struct same_static_key
+			: std::integral_constant<bool, is_bkey<A>::value && std::is_same<A, B>::value> {};
+
+		// true if no compile-time key among Keys occurs twice
+		template<typename... Keys> struct static_keys_unique : std::true_type {};
+		template<typename K, typename... Rest> struct static_keys_unique<K, Rest...>
+			: std::integral_constant<bool,
+				!any_of<same_static_key<K, Rest>::value...>::value
+				&& static_keys_unique<Rest...>::value> {};
+
+		template<typename A> struct is_valid_key_type : std::integral_constant<bool,
+			is_bkey<A>::value
+				|| std::is_convertible<A, std::vector<unsigned char>>::value
 				|| std::is_convertible<A, std::vector<char>>::value
 				|| std::is_convertible<A, const char*>::value
 				|| std::is_convertible<A, std::string>::value
-				|| is_unsigned_char_array<A>::value
-				, "Bencoded dictionary key must be a char*, an std::vector<unsigned char>"
-				", or an std::array<unsigned char, N>.");
+				|| std::is_convertible<A, bstring_view>::value
+				|| is_unsigned_char_array<A>::value> {};
+
+
+		// the integer type T is encoded as: T itself, or the underlying type of
+		// an enum
+		template<typename T, bool = std::is_enum<T>::value> struct integer_of {
+			typedef T type;
+		};
+		template<typename T> struct integer_of<T, true> {
+			typedef typename std::underlying_type<T>::type type;
+		};
+
+		// every integral type other than bool and the character types is
+		// bencoded as an integer, and so are unscoped enums, which convert to
+		// their underlying type implicitly; scoped enums have to be cast
+		template<typename T, typename I = typename integer_of<T>::type>
+			struct is_bencodable_integer : std::integral_constant<bool,
+			std::is_integral<I>::value && !std::is_same<I, bool>::value
+				&& !std::is_same<I, char>::value && !std::is_same<I, wchar_t>::value
+				&& !std::is_same<I, char16_t>::value
+				&& !std::is_same<I, char32_t>::value
+				&& std::is_convertible<T, I>::value> {};
+
+		template<typename T> constexpr bool is_negative(T value, std::true_type) {
+			return value < 0;
+		}
+		template<typename T> constexpr bool is_negative(T, std::false_type) {
+			return false;
+		}
+
+		// absolute value of an integer of any width or signedness
+		template<typename T> constexpr std::uint64_t magnitude(T value,
+				bool negative) {
+			return negative ? 0 - std::uint64_t(value) : std::uint64_t(value);
+		}
+
+		constexpr size_t count_digits(std::uint64_t value) {
+			return value < 10 ? 1 : value < 100 ? 2 : value < 1000 ? 3
+				: value < 10000 ? 4 : 4 + count_digits(value / 10000);
 		}
-		template<typename Head> void assert_valid_key_types() {
-			assert_valid_key_type<Head>();
+
+		constexpr size_t cstrlen(char const* value) {
+#if defined __GNUC__ || defined __clang__
+			return __builtin_strlen(value);
+#else
+			return *value ? 1 + cstrlen(value + 1) : 0;
+#endif
 		}
-		template<typename Head, typename Middle, typename... Tail>
-			void assert_valid_key_types() {
-			assert_valid_key_type<Head>();
-			assert_valid_key_types<Middle, Tail...>();
+
+		// writes the decimal digits of value so that the last one lands just
+		// before end; the caller has to have made room for count_digits(value)
+		inline void format_digits(unsigned char* end, std::uint64_t value) {
+			static const char digit_pairs[] =
+				"00010203040506070809101112131415161718192021222324"
+				"25262728293031323334353637383940414243444546474849"
+				"50515253545556575859606162636465666768697071727374"
+				"75767778798081828384858687888990919293949596979899";
+			while (value >= 100) {
+				const char* pair = digit_pairs + (value % 100) * 2;
+				value /= 100;
+				*--end = pair[1];
+				*--end = pair[0];
+			}
+			if (value >= 10) {
+				const char* pair = digit_pairs + value * 2;
+				*--end = pair[1];
+				*--end = pair[0];
+			} else {
+				*--end = static_cast<unsigned char>('0' + value);
+			}
 		}
 	}
 
-	const static detail::bencode_token bdict_begin = {'d'};
-	const static detail::bencode_token bdict_end = {'e'};
-	const static detail::bencode_token blist_begin = {'l'};
-	const static detail::bencode_token blist_end = {'e'};
+	constexpr static detail::bencode_token bdict_begin = {'d'};
+	constexpr static detail::bencode_token bdict_end = {'e'};
+	constexpr static detail::bencode_token blist_begin = {'l'};
+	constexpr static detail::bencode_token blist_end = {'e'};
 
 	
-	template<typename A, typename B> std::tuple<A, B> k_v(A &&a, B &&b) {
-		detail::assert_valid_key_type<A>();
+	// a dictionary key as a compile-time constant, e.g. k_v(EBB_KEY("id"), id);
+	// bdict rejects such keys at compile time if they are out of order, and
+	// bsorted_dict orders them without any work at runtime
+#define EBB_KEY(s) ::ebb::detail::make_bkey<sizeof(s) - 1, \
+	EBB_DETAIL_CHARS_8(s, 0), EBB_DETAIL_CHARS_8(s, 8), \
+	EBB_DETAIL_CHARS_8(s, 16), EBB_DETAIL_CHARS_8(s, 24)>::type()
+#define EBB_DETAIL_CHARS_8(s, i) \
+	::ebb::detail::char_at(s, i), ::ebb::detail::char_at(s, i + 1), \
+	::ebb::detail::char_at(s, i + 2), ::ebb::detail::char_at(s, i + 3), \
+	::ebb::detail::char_at(s, i + 4), ::ebb::detail::char_at(s, i + 5), \
+	::ebb::detail::char_at(s, i + 6), ::ebb::detail::char_at(s, i + 7)
+
+	template<typename A, typename B> constexpr std::tuple<A, B> k_v(A &&a, B &&b) {
+		static_assert(detail::is_valid_key_type<A>::value,
+				"Bencoded dictionary key must be a char*, an std::vector<unsigned char>"
+				", an std::array<unsigned char, N>, a bstring_view or an EBB_KEY.");
 		return std::forward_as_tuple(a, b);
 	}
 
-	template<typename... Arguments> std::tuple<detail::bencode_token, Arguments...,
-		detail::bencode_token> blist(Arguments&&... remaining) {
+	template<typename... Arguments> constexpr std::tuple<detail::bencode_token,
+		Arguments..., detail::bencode_token> blist(Arguments&&... remaining) {
 		return std::forward_as_tuple(blist_begin, remaining..., blist_end);
 	}
 
-	template<typename... A, typename... B> std::tuple<detail::bencode_token,
-		std::tuple<A,B>..., detail::bencode_token> bdict(
+	template<typename... A, typename... B> constexpr std::tuple<
+		detail::bencode_token, std::tuple<A,B>..., detail::bencode_token> bdict(
 				std::tuple<A, B>&&... remaining) {
-		detail::assert_valid_key_types<A...>();
+		static_assert(detail::all_of<detail::is_valid_key_type<A>::value...>::value,
+				"Bencoded dictionary key must be a char*, an std::vector<unsigned char>"
+				", an std::array<unsigned char, N>, a bstring_view or an EBB_KEY.");
+		static_assert(detail::static_keys_ascending<
+				typename std::decay<A>::type...>::value,
+				"EBB_KEY keys of a bdict must be sorted and unique; use bsorted_dict to "
+				"have them put in order.");
 		return std::forward_as_tuple(bdict_begin, remaining..., bdict_end);
 	}
 
-	class bencoder {
+	namespace detail {
+		// dict entries to be emitted in bencode key order rather than as given
+		template<typename... Entries> struct sorted_entries {
+			std::tuple<Entries...> entries;
+		};
+
+		template<typename... Keys> struct all_static_keys
+			: all_of<is_bkey<Keys>::value...> {};
+
+		// number of Keys less than Key
+		template<typename Key, typename... Keys> struct key_rank;
+		template<typename Key> struct key_rank<Key>
+			: std::integral_constant<size_t, 0> {};
+		template<typename Key, typename K, typename... Keys> struct key_rank<Key, K,
+			Keys...> : std::integral_constant<size_t, bkey_less<K, Key>::value
+				+ key_rank<Key, Keys...>::value> {};
+
+		// position I of the entry whose key has rank P among all keys
+		template<size_t P, size_t I, size_t... Ranks> struct entry_with_rank;
+		template<size_t P, size_t I, size_t R, size_t... Ranks> struct
+			entry_with_rank<P, I, R, Ranks...> : std::conditional<P == R,
+				std::integral_constant<size_t, I>,
+				entry_with_rank<P, I + 1, Ranks...>>::type {};
+
+		template<typename Ranks, typename Positions> struct order_by_rank;
+		template<size_t... Ranks, int... P> struct order_by_rank<
+			std::tuple<std::integral_constant<size_t, Ranks>...>, seq<P...>> {
+			typedef seq<entry_with_rank<P, 0, Ranks...>::value...> type;
+		};
+
+		// the order in which to emit entries whose keys are all EBB_KEYs
+		template<typename... Keys> struct static_key_order : order_by_rank<
+			std::tuple<std::integral_constant<size_t, key_rank<Keys, Keys...>::value>...>,
+			typename gen_seq<sizeof...(Keys)>::type> {};
+	}
+
+	// like bdict, but the encoder emits the entries sorted by key, as bencode
+	// requires; the order of EBB_KEY keys is worked out at compile time, other
+	// keys are sorted on the stack while encoding, and encoding fails if two
+	// keys are equal
+	template<typename... A, typename... B> constexpr detail::sorted_entries<
+		std::tuple<A, B>...> bsorted_dict(std::tuple<A, B>&&... remaining) {
+		static_assert(detail::all_of<detail::is_valid_key_type<A>::value...>::value,
+				"Bencoded dictionary key must be a char*, an std::vector<unsigned char>"
+				", an std::array<unsigned char, N>, a bstring_view or an EBB_KEY.");
+		static_assert(detail::static_keys_unique<typename std::decay<A>::type...>::value,
+				"EBB_KEY keys of a bsorted_dict must be unique.");
+		return detail::sorted_entries<std::tuple<A, B>...>{
+			std::forward_as_tuple(remaining...)};
+	}
+
+	// a value that is left out when absent; as a dict value, the whole entry is
+	// skipped. Holds a pointer, so the value has to outlive the encoding
+	template<typename T> class boptional {
 		private:
-			unsigned char* buffer;
-			size_t len;
+			const T* ptr;
 		public:
-			bencoder(unsigned char* buffer, size_t len) : buffer(buffer), len(len) {};
-			template<size_t Size> bencoder(std::array<unsigned char, Size>& buffer) :
-				buffer(buffer.data()), len(buffer.size()) {};
-			template<typename... Arguments> unsigned char* operator()
-				(Arguments&&... remaining) {
-					assert(buffer);
-					return bencode(remaining...);
+			constexpr explicit boptional(const T* value) : ptr(value) {};
+			constexpr bool has_value() const { return ptr != NULL; }
+			constexpr const T& operator*() const { return *ptr; }
+	};
+
+	template<typename T> boptional<T> bopt(const T& value, bool present) {
+		return boptional<T>(present ? &value : NULL);
+	}
+
+	template<typename T> boptional<T> bopt(const T* value) {
+		return boptional<T>(value);
+	}
+
+	namespace detail {
+		template<typename Iterator> struct iterator_range {
+			Iterator first;
+			Iterator last;
+		};
+
+		template<typename> struct is_optional : std::false_type {};
+		template<typename T> struct is_optional<boptional<T>> : std::true_type {};
+#if __cplusplus >= 201703L
+		template<typename T> struct is_optional<std::optional<T>> : std::true_type {};
+#endif
+
+		// dict entries from k_v whose value is absent are skipped entirely
+		template<typename A, typename B> constexpr bool is_absent_entry(
+				std::tuple<A, B> const& entry, std::true_type) {
+			return !std::get<1>(entry).has_value();
+		}
+		template<typename A, typename B> constexpr bool is_absent_entry(
+				std::tuple<A, B> const&, std::false_type) {
+			return false;
+		}
+		template<typename A, typename B> constexpr bool is_absent_entry(
+				std::tuple<A, B> const& entry) {
+			return is_absent_entry(entry,
+					is_optional<typename std::decay<B>::type>());
+		}
+
+		// raw bytes of a runtime dictionary key
+		inline bstring_view key_bytes(std::string const& key) {
+			return bstring_view(reinterpret_cast<const unsigned char*>(key.data()),
+					key.size());
+		}
+		inline bstring_view key_bytes(std::vector<unsigned char> const& key) {
+			return bstring_view(key.data(), key.size());
+		}
+		inline bstring_view key_bytes(std::vector<char> const& key) {
+			return bstring_view(reinterpret_cast<const unsigned char*>(key.data()),
+					key.size());
+		}
+		inline bstring_view key_bytes(char const* key) {
+			return bstring_view(reinterpret_cast<const unsigned char*>(key),
+					strlen(key));
+		}
+		inline bstring_view key_bytes(bstring_view const& key) {
+			return key;
+		}
+		template<size_t N> bstring_view key_bytes(
+				std::array<unsigned char, N> const& key) {
+			return bstring_view(key.data(), N);
+		}
+		template<char... C> bstring_view key_bytes(bkey<C...> const&) {
+			return bstring_view(bkey<C...>::data, sizeof...(C));
+		}
+
+		// bencode orders dict keys as raw byte strings
+		inline bool key_less(bstring_view const& a, bstring_view const& b) {
+			int order = std::memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+			return order < 0 || (order == 0 && a.size() < b.size());
+		}
+
+		// maps whose iteration order already is bencode's key order
+		template<typename> struct is_canonically_ordered : std::false_type {};
+		template<typename V, typename A> struct is_canonically_ordered<
+			std::map<std::string, V, std::less<std::string>, A>> : std::true_type {};
+		template<typename V, typename A> struct is_canonically_ordered<
+			std::map<std::vector<unsigned char>, V,
+				std::less<std::vector<unsigned char>>, A>> : std::true_type {};
+
+		// largest unordered map whose entries are sorted in a buffer on the stack
+		const static size_t sort_batch = 64;
+
+		// orders map entries by their keys in bencode order
+		template<typename Entry> struct entry_key_less {
+			bool operator()(const Entry* a, const Entry* b) const {
+				return key_less(key_bytes(a->first), key_bytes(b->first));
+			}
+		};
+
+		// calls emit(entry) for every entry of map in bencode key order, sorting
+		// pointers to the entries in order, which has room for map.size() of them
+		template<typename Map, typename Emit> bool emit_sorted(Map const& map,
+				Emit emit, typename Map::value_type const** order) {
+			typedef typename Map::value_type entry;
+			size_t n = 0;
+			for (typename Map::const_iterator it = map.begin(); it != map.end(); ++it) {
+				order[n++] = &*it;
+			}
+			std::sort(order, order + n, entry_key_less<entry>());
+			for (size_t i = 0; i < n; i++) {
+				if (!emit(*order[i])) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// like emit_sorted(), sorting on the stack for up to sort_batch entries
+		// and in an array sized from map.size() beyond that; pass the map through
+		// bsorted_map() to supply that array instead
+		template<typename Map, typename Emit> bool for_each_sorted(Map const& map,
+				Emit emit) {
+			typedef typename Map::value_type entry;
+			if (map.size() <= sort_batch) {
+				const entry* order[sort_batch];
+				return emit_sorted(map, emit, order);
+			}
+			std::vector<const entry*> order(map.size());
+			return emit_sorted(map, emit, order.data());
+		}
+
+		// an unordered map with caller supplied room for sorting its entries
+		template<typename Map> struct scratch_sorted_map {
+			Map const* map;
+			typename Map::value_type const** scratch;
+			size_t capacity;
+		};
+	}
+
+	// encodes map, typically an std::unordered_map, as a dict sorted in
+	// scratch, which holds capacity entry pointers, so that maps too large to
+	// sort on the stack are encoded without allocating; if map has more
+	// entries than that, it is sorted as if passed directly
+	template<typename Map> detail::scratch_sorted_map<Map> bsorted_map(
+			Map const& map, typename Map::value_type const** scratch,
+			size_t capacity) {
+		detail::scratch_sorted_map<Map> sorted = {&map, scratch, capacity};
+		return sorted;
+	}
+
+	// a list of the values in [first, last)
+	template<typename Iterator> detail::iterator_range<Iterator> brange(
+			Iterator first, Iterator last) {
+		detail::iterator_range<Iterator> range = {first, last};
+		return range;
+	}
+
+	namespace detail {
+		inline std::uint32_t rotl(std::uint32_t value, int bits) {
+			return (value << bits) | (value >> (32 - bits));
+		}
+		inline std::uint32_t rotr(std::uint32_t value, int bits) {
+			return (value >> bits) | (value << (32 - bits));
+		}
+		inline std::uint32_t load_be32(const unsigned char* p) {
+			return std::uint32_t(p[0]) << 24 | std::uint32_t(p[1]) << 16
+				| std::uint32_t(p[2]) << 8 | std::uint32_t(p[3]);
+		}
+		inline void store_be32(unsigned char* p, std::uint32_t value) {
+			p[0] = static_cast<unsigned char>(value >> 24);
+			p[1] = static_cast<unsigned char>(value >> 16);
+			p[2] = static_cast<unsigned char>(value >> 8);
+			p[3] = static_cast<unsigned char>(value);
+		}
+
+		// block buffering and Merkle-Damgard padding shared by sha1 and sha256;
+		// Derived provides compress(const unsigned char* block) and
+		// store_state(unsigned char* digest)
+		template<typename Derived> class md_hasher {
+			private:
+				unsigned char block[64];
+				size_t used;
+				std::uint64_t total;
+			protected:
+				md_hasher() : used(0), total(0) {};
+
+				void pad() {
+					std::uint64_t bits = total * 8;
+					unsigned char marker = 0x80;
+					update(&marker, 1);
+					static const unsigned char zeros[64] = {0};
+					update(zeros, (used <= 56 ? 56 : 120) - used);
+					unsigned char length[8];
+					store_be32(length, std::uint32_t(bits >> 32));
+					store_be32(length + 4, std::uint32_t(bits));
+					update(length, 8);
+				}
+			public:
+				void update(const unsigned char* data, size_t size) {
+					total += size;
+					if (used) {
+						size_t n = std::min(size, sizeof(block) - used);
+						std::memcpy(block + used, data, n);
+						used += n;
+						data += n;
+						size -= n;
+						if (used < sizeof(block)) {
+							return;
+						}
+						static_cast<Derived*>(this)->compress(block);
+						used = 0;
+					}
+					for (; size >= sizeof(block); data += sizeof(block),
+							size -= sizeof(block)) {
+						static_cast<Derived*>(this)->compress(data);
+					}
+					if (size) {
+						std::memcpy(block, data, size);
+						used = size;
+					}
 				}
+		};
+	}
 
+	// incremental SHA-1, for v1 info-hashes and piece hashes
+	class sha1 : public detail::md_hasher<sha1> {
+		friend class detail::md_hasher<sha1>;
 		private:
-			unsigned char* bencode() {
-				return buffer;
+			std::uint32_t state[5];
+		public:
+			static const size_t digest_size = 20;
+
+			sha1() {
+				state[0] = 0x67452301;
+				state[1] = 0xefcdab89;
+				state[2] = 0x98badcfe;
+				state[3] = 0x10325476;
+				state[4] = 0xc3d2e1f0;
 			}
 
-			template<typename... Arguments> unsigned char* bencode(std::int64_t value,
-					Arguments&&... remaining) {
-				long written = snprintf(reinterpret_cast<char*>(buffer), len,
-						"i%" PRId64 "e", value);
-				if (written > len) {
-					buffer = NULL;
-					return NULL;
+			// pads the message and returns its digest; the hasher is spent
+			std::array<unsigned char, digest_size> final() {
+				pad();
+				std::array<unsigned char, digest_size> digest;
+				for (int i = 0; i < 5; i++) {
+					detail::store_be32(digest.data() + i * 4, state[i]);
 				}
-				buffer += written;
-				len -= written;
-				return bencode(remaining...);
+				return digest;
+			}
+
+		private:
+			void compress(const unsigned char* block) {
+				std::uint32_t w[80];
+				for (int i = 0; i < 16; i++) {
+					w[i] = detail::load_be32(block + i * 4);
+				}
+				for (int i = 16; i < 80; i++) {
+					w[i] = detail::rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+				}
+				std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+					e = state[4];
+				for (int i = 0; i < 80; i++) {
+					std::uint32_t f, k;
+					if (i < 20) {
+						f = (b & c) | (~b & d);
+						k = 0x5a827999;
+					} else if (i < 40) {
+						f = b ^ c ^ d;
+						k = 0x6ed9eba1;
+					} else if (i < 60) {
+						f = (b & c) | (b & d) | (c & d);
+						k = 0x8f1bbcdc;
+					} else {
+						f = b ^ c ^ d;
+						k = 0xca62c1d6;
+					}
+					std::uint32_t t = detail::rotl(a, 5) + f + e + k + w[i];
+					e = d;
+					d = c;
+					c = detail::rotl(b, 30);
+					b = a;
+					a = t;
+				}
+				state[0] += a;
+				state[1] += b;
+				state[2] += c;
+				state[3] += d;
+				state[4] += e;
+			}
+	};
+
+	// incremental SHA-256, for v2 info-hashes and merkle trees
+	class sha256 : public detail::md_hasher<sha256> {
+		friend class detail::md_hasher<sha256>;
+		private:
+			std::uint32_t state[8];
+		public:
+			static const size_t digest_size = 32;
+
+			sha256() {
+				state[0] = 0x6a09e667;
+				state[1] = 0xbb67ae85;
+				state[2] = 0x3c6ef372;
+				state[3] = 0xa54ff53a;
+				state[4] = 0x510e527f;
+				state[5] = 0x9b05688c;
+				state[6] = 0x1f83d9ab;
+				state[7] = 0x5be0cd19;
+			}
+
+			// pads the message and returns its digest; the hasher is spent
+			std::array<unsigned char, digest_size> final() {
+				pad();
+				std::array<unsigned char, digest_size> digest;
+				for (int i = 0; i < 8; i++) {
+					detail::store_be32(digest.data() + i * 4, state[i]);
+				}
+				return digest;
+			}
+
+		private:
+			void compress(const unsigned char* block) {
+				static const std::uint32_t k[64] = {
+					0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+					0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+					0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+					0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+					0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+					0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+					0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+					0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+					0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+					0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+					0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+				std::uint32_t w[64];
+				for (int i = 0; i < 16; i++) {
+					w[i] = detail::load_be32(block + i * 4);
+				}
+				for (int i = 16; i < 64; i++) {
+					std::uint32_t s0 = detail::rotr(w[i - 15], 7) ^ detail::rotr(w[i - 15], 18)
+						^ (w[i - 15] >> 3);
+					std::uint32_t s1 = detail::rotr(w[i - 2], 17) ^ detail::rotr(w[i - 2], 19)
+						^ (w[i - 2] >> 10);
+					w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+				}
+				std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+					e = state[4], f = state[5], g = state[6], h = state[7];
+				for (int i = 0; i < 64; i++) {
+					std::uint32_t s1 = detail::rotr(e, 6) ^ detail::rotr(e, 11)
+						^ detail::rotr(e, 25);
+					std::uint32_t ch = (e & f) ^ (~e & g);
+					std::uint32_t t1 = h + s1 + ch + k[i] + w[i];
+					std::uint32_t s0 = detail::rotr(a, 2) ^ detail::rotr(a, 13)
+						^ detail::rotr(a, 22);
+					std::uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+					std::uint32_t t2 = s0 + maj;
+					h = g;
+					g = f;
+					f = e;
+					e = d + t1;
+					d = c;
+					c = b;
+					b = a;
+					a = t1 + t2;
+				}
+				state[0] += a;
+				state[1] += b;
+				state[2] += c;
+				state[3] += d;
+				state[4] += e;
+				state[5] += f;
+				state[6] += g;
+				state[7] += h;
 			}
+	};
+
+	namespace detail {
+		template<typename Hasher, typename T> struct hashed {
+			Hasher* hasher;
+			T value;
+		};
+
+		// a hasher fed by a bsink_encoder while it emits a bhashed value; nested
+		// bhashed values form a chain on the stack
+		struct hash_tap {
+			void (*update)(void*, const unsigned char*, size_t);
+			void* hasher;
+			hash_tap* next;
+		};
+
+		template<typename Hasher> void update_hasher(void* hasher,
+				const unsigned char* data, size_t size) {
+			static_cast<Hasher*>(hasher)->update(data, size);
+		}
+	}
+
+	// encodes value as usual while also feeding exactly its encoded bytes to
+	// hasher, e.g. k_v("info", bhashed(info_hash, bdict(...))) computes the
+	// info-hash in the same pass; a Hasher only needs
+	// update(const unsigned char*, size_t), so sha1, sha256 or any other will do
+	template<typename Hasher, typename T> constexpr detail::hashed<Hasher, T> bhashed(
+			Hasher& hasher, T&& value) {
+		return detail::hashed<Hasher, T>{&hasher, std::forward<T>(value)};
+	}
+
+	// placeholder for a fixed-width string, e.g. a node or transaction ID, in a
+	// message that is encoded once and then patched; bencoder writes Width zero
+	// bytes for it and records where they went relative to its start, so a
+	// slot belongs to whichever message was encoded with it last
+	template<size_t Width> struct bslot {
+		size_t offset;
+
+		constexpr bslot() : offset(0) {};
 
-			template<typename... Arguments> unsigned char* bencode(char const *value,
-					Arguments&&... remaining) {
-				long written = snprintf(reinterpret_cast<char*>(buffer), len,
-						"%" PRId64 ":%s", std::int64_t(strlen(value)), value);
-				if (written > len) {
-					buffer = NULL;
+		void patch(unsigned char* message, const unsigned char* value) const {
+			std::memcpy(message + offset, value, Width);
+		}
+		void patch(unsigned char* message,
+				std::array<unsigned char, Width> const& value) const {
+			patch(message, value.data());
+		}
+	};
+
+	enum class btype : unsigned char { integer, string, list, dict };
+
+	class bview;
+
+	// bump allocator over a caller supplied buffer, e.g. a per-thread pool that
+	// is reset between documents; allocate() returns NULL once the buffer runs
+	// out. Anything with the same allocate() can be used as a bvalue arena
+	class barena {
+		private:
+			unsigned char* buffer;
+			size_t capacity;
+			size_t used;
+		public:
+			barena(unsigned char* buffer, size_t capacity) : buffer(buffer),
+				capacity(capacity), used(0) {};
+			template<size_t Size> barena(std::array<unsigned char, Size>& buffer) :
+				barena(buffer.data(), buffer.size()) {};
+
+			void* allocate(size_t size, size_t alignment) {
+				std::uintptr_t next = reinterpret_cast<std::uintptr_t>(buffer + used);
+				size_t offset = used + ((alignment - next % alignment) % alignment);
+				if (offset > capacity || size > capacity - offset) {
 					return NULL;
 				}
-				buffer += written;
-				len -= written;
-				return bencode(remaining...);
+				used = offset + size;
+				return buffer + offset;
+			}
+
+			// frees everything allocated so far at once
+			void reset() { used = 0; }
+
+			// bytes allocated so far, including alignment padding
+			size_t size() const { return used; }
+	};
+
+	// mutable bencoded value for editing documents, e.g. rewriting a .torrent;
+	// child arrays and copied strings are allocated from an arena passed to
+	// each modifying call, so a whole tree is freed by resetting its arena.
+	// Strings refer to the buffer they were loaded from until assigned. A list
+	// keeps its elements and a dict its alternating keys and values in one
+	// contiguous array, dict keys in canonical order, so the tree is encoded
+	// as is by passing it to bencoder
+	class bvalue {
+		private:
+			union {
+				std::int64_t number;
+				std::uint64_t unsigned_number;
+				const unsigned char* bytes;
+				bvalue* items;
+			};
+			// string bytes, list elements or dict entries
+			size_t count;
+			// list elements or dict entries that fit in items
+			std::uint32_t capacity;
+			btype kind;
+			// an unsigned integer above INT64_MAX, held in unsigned_number
+			bool large;
+		public:
+			// an empty list or dict, or 0 or an empty string
+			explicit bvalue(btype type = btype::dict) : items(NULL), count(0),
+				capacity(0), kind(type), large(false) {
+				if (type == btype::integer) {
+					number = 0;
+				}
 			}
+			// any integer type, so that bvalue(0) is not taken for a null string
+			template<typename T, typename = typename std::enable_if<
+				detail::is_bencodable_integer<T>::value>::type>
+				explicit bvalue(T value) : number(std::int64_t(value)), count(0),
+				capacity(0), kind(btype::integer),
+				large(!std::is_signed<typename detail::integer_of<T>::type>::value
+						&& std::uint64_t(value) > std::uint64_t(INT64_MAX)) {};
+			// refers to value, which has to outlive the tree
+			explicit bvalue(bstring_view value) : bytes(value.data()),
+				count(value.size()), capacity(0), kind(btype::string), large(false) {};
+			explicit bvalue(char const* value) : bvalue(bstring_view(
+						reinterpret_cast<const unsigned char*>(value), strlen(value))) {};
 
-			template<typename... Arguments> unsigned char* bencode(
-					std::vector<unsigned char> const &value, Arguments&&... remaining) {
-				return bencode_listish(value, remaining...);
+			btype type() const { return kind; }
+			bool is_integer() const { return kind == btype::integer; }
+			bool is_string() const { return kind == btype::string; }
+			bool is_list() const { return kind == btype::list; }
+			bool is_dict() const { return kind == btype::dict; }
+
+			// whether integer() can return the value; false only for unsigned
+			// values above INT64_MAX, which uinteger() returns instead
+			bool is_int64() const { return is_integer() && !large; }
+
+			std::int64_t integer() const {
+				assert(is_int64());
+				return number;
 			}
 
-			template<typename... Arguments> unsigned char* bencode(
-					std::vector<char> const &value, Arguments&&... remaining) {
-				return bencode_listish(value, remaining...);
+			// the value of a non-negative integer, including ones above INT64_MAX
+			std::uint64_t uinteger() const {
+				assert(is_integer() && (large || number >= 0));
+				return unsigned_number;
 			}
 
-			template<typename... Arguments> unsigned char* bencode(
-					std::string const &value, Arguments&&... remaining) {
-				return bencode_listish(value, remaining...);
+			bstring_view string() const {
+				assert(is_string());
+				return bstring_view(bytes, count);
 			}
 
-			template<size_t N, typename... Arguments> unsigned char* bencode(
-					std::array<const unsigned char, N> const &value,
-					Arguments&&... remaining) {
-				return bencode_listish(value, remaining...);
+			// number of list elements or dict entries
+			size_t size() const {
+				assert(is_list() || is_dict());
+				return count;
 			}
 
-			template<size_t N, typename... Arguments> unsigned char* bencode(
-					std::array<unsigned char, N> const &value, Arguments&&... remaining) {
-				return bencode_listish(value, remaining...);
+			// the elements of a list, or the alternating keys and values of a dict
+			bvalue* begin() { return items; }
+			bvalue* end() { return items + slots(count); }
+			const bvalue* begin() const { return items; }
+			const bvalue* end() const { return items + slots(count); }
+
+			bvalue& operator[](size_t i) {
+				assert(is_list() && i < count);
+				return items[i];
+			}
+			bvalue const& operator[](size_t i) const {
+				assert(is_list() && i < count);
+				return items[i];
 			}
 
-			template<typename... Arguments> unsigned char* bencode(
-					detail::bencode_token const value, Arguments&&... remaining) {
-				if (len == 0) {
-					buffer = NULL;
-					return NULL;
+			// value stored under key, or NULL if there is none
+			bvalue* find(bstring_view key) {
+				assert(is_dict());
+				for (size_t i = 0; i < count; i++) {
+					if (items[2 * i].string() == key) {
+						return &items[2 * i + 1];
+					}
 				}
-				*buffer = value.token;
-				buffer++;
-				len--;
-				return bencode(remaining...);
+				return NULL;
+			}
+			const bvalue* find(bstring_view key) const {
+				return const_cast<bvalue*>(this)->find(key);
+			}
+			bvalue* find(char const* key) {
+				return find(bstring_view(reinterpret_cast<const unsigned char*>(key),
+							strlen(key)));
+			}
+			const bvalue* find(char const* key) const {
+				return const_cast<bvalue*>(this)->find(key);
 			}
 
-			template<typename... TupleTypes, typename... Arguments>
-				unsigned char* bencode(std::tuple<TupleTypes...> const &value,
-						Arguments... remaining) {
-				return bencode(typename detail::gen_seq<sizeof...(TupleTypes)>::type(),
-						value, remaining...);
+			// replaces the value with a string copied into arena, so it no longer
+			// refers to any outside buffer
+			template<typename Arena> bool assign(Arena& arena, bstring_view value) {
+				unsigned char* copy = static_cast<unsigned char*>(
+						arena.allocate(value.size(), 1));
+				if (!copy && value.size()) {
+					return false;
+				}
+				if (value.size()) {
+					std::memcpy(copy, value.data(), value.size());
+				}
+				*this = bvalue(bstring_view(copy, value.size()));
+				return true;
 			}
 
-			template<int... S, typename... TupleTypes, typename... Arguments>
-				unsigned char* bencode(detail::seq<S...>,
-						std::tuple<TupleTypes...> const &value, Arguments... remaining) {
-				return bencode(std::get<S>(value)..., remaining...);
+			template<typename Arena> bool push_back(Arena& arena, bvalue const& value) {
+				assert(is_list());
+				if (count == capacity && !reserve(arena, count ? 2 * count : 4)) {
+					return false;
+				}
+				items[count++] = value;
+				return true;
 			}
-			
-			template<typename T, typename... Arguments>
-			unsigned char* bencode_listish(T const& value, Arguments&&... remaining) {
-				if (value.size() > INT64_MAX) {
-					buffer = NULL;
-					return NULL;
+
+			// stores value under key, copying a new key into arena and inserting it
+			// at its canonical position; returns the stored value, or NULL if the
+			// arena ran out
+			template<typename Arena> bvalue* set(Arena& arena, bstring_view key,
+					bvalue const& value) {
+				assert(is_dict());
+				size_t i = 0;
+				for (; i < count && detail::key_less(items[2 * i].string(), key); i++) {
 				}
-				long written = snprintf(reinterpret_cast<char*>(buffer), len,
-						"%" PRId64 ":" , std::int64_t(value.size()));
-				if (written + value.size() > len) {
-					buffer = NULL;
+				if (i < count && items[2 * i].string() == key) {
+					items[2 * i + 1] = value;
+					return &items[2 * i + 1];
+				}
+				bvalue stored_key;
+				if ((count == capacity && !reserve(arena, count ? 2 * count : 4))
+						|| !stored_key.assign(arena, key)) {
 					return NULL;
 				}
-				std::memcpy(buffer + written, &value[0], value.size());
-				buffer += written + value.size();
-				len -= written + value.size();
-				return bencode(remaining...);
+				std::memmove(items + 2 * i + 2, items + 2 * i,
+						(count - i) * 2 * sizeof(bvalue));
+				items[2 * i] = stored_key;
+				items[2 * i + 1] = value;
+				count++;
+				return &items[2 * i + 1];
+			}
+			template<typename Arena> bvalue* set(Arena& arena, char const* key,
+					bvalue const& value) {
+				return set(arena, bstring_view(reinterpret_cast<const unsigned char*>(key),
+							strlen(key)), value);
+			}
+
+			// removes the entry under key; returns whether there was one
+			bool erase(bstring_view key) {
+				bvalue* value = find(key);
+				if (!value) {
+					return false;
+				}
+				std::memmove(value - 1, value + 1, (end() - value - 1) * sizeof(bvalue));
+				count--;
+				return true;
+			}
+			bool erase(char const* key) {
+				return erase(bstring_view(reinterpret_cast<const unsigned char*>(key),
+							strlen(key)));
+			}
+
+			// removes the list element at index i; takes any integer type so that
+			// erase(0) is not taken for a null key
+			template<typename T> typename std::enable_if<
+				detail::is_bencodable_integer<T>::value>::type erase(T i) {
+				size_t index = size_t(i);
+				assert(is_list() && !detail::is_negative(i,
+							std::is_signed<typename detail::integer_of<T>::type>())
+						&& index < count);
+				std::memmove(items + index, items + index + 1,
+						(count - index - 1) * sizeof(bvalue));
+				count--;
+			}
+
+			// makes room for at least entries list elements or dict entries
+			template<typename Arena> bool reserve(Arena& arena, size_t entries) {
+				assert(is_list() || is_dict());
+				if (entries <= capacity) {
+					return true;
+				}
+				if (entries > UINT32_MAX) {
+					return false;
+				}
+				bvalue* grown = static_cast<bvalue*>(arena.allocate(
+							slots(entries) * sizeof(bvalue), alignof(bvalue)));
+				if (!grown) {
+					return false;
+				}
+				if (count) {
+					std::memcpy(grown, items, slots(count) * sizeof(bvalue));
+				}
+				items = grown;
+				capacity = std::uint32_t(entries);
+				return true;
+			}
+
+			// replaces the value with a tree built from source, allocated from
+			// arena; strings keep referring to the decoded buffer. Fails if the
+			// arena runs out or source is nested deeper than max_depth
+			template<typename Arena> bool load(Arena& arena, bview source,
+					size_t max_depth = 64);
+
+		private:
+			size_t slots(size_t entries) const {
+				return kind == btype::dict ? 2 * entries : entries;
+			}
+	};
+
+	namespace detail {
+		// one member of a struct declared with EBB_FIELDS, keyed by its name
+		template<typename Key, typename T, typename M> struct field {
+			typedef Key key;
+			typedef M type;
+			M T::* member;
+		};
+
+		template<typename Key, typename T, typename M> constexpr field<Key, T, M>
+			make_field(Key, M T::* member) {
+			return field<Key, T, M>{member};
+		}
+
+		// whether EBB_FIELDS was declared for T
+		template<typename T, typename = void> struct has_fields : std::false_type {};
+		template<typename T> struct has_fields<T, decltype(
+				(void)ebb_fields(static_cast<T const*>(NULL)))> : std::true_type {};
+
+		template<typename T> struct fields_of {
+			typedef decltype(ebb_fields(static_cast<T const*>(NULL))) schema;
+		};
+
+		template<typename Schema> struct bound_entries;
+		template<typename... Fields> struct bound_entries<std::tuple<Fields...>> {
+			typedef sorted_entries<std::tuple<typename Fields::key,
+					typename Fields::type const&>...> type;
+		};
+
+		template<typename T, typename... Fields, int... S>
+			typename bound_entries<std::tuple<Fields...>>::type bind_fields(
+					T const& value, std::tuple<Fields...> const& schema, seq<S...>) {
+			static_assert(static_keys_unique<typename Fields::key...>::value,
+					"EBB_FIELDS members must have distinct names.");
+			typedef typename bound_entries<std::tuple<Fields...>>::type entries_type;
+			return entries_type{std::make_tuple(std::tuple<typename Fields::key,
+					typename Fields::type const&>(typename Fields::key(),
+						value.*std::get<S>(schema).member)...)};
+		}
+
+		template<typename Schema> struct schema_seq;
+		template<typename... Fields> struct schema_seq<std::tuple<Fields...>>
+			: gen_seq<sizeof...(Fields)> {};
+
+		// the order of the fields by key
+		template<typename Schema> struct schema_order;
+		template<typename... Fields> struct schema_order<std::tuple<Fields...>>
+			: static_key_order<typename Fields::key...> {};
+	}
+
+	// the members of a struct declared with EBB_FIELDS as a dict whose keys are
+	// put in order at compile time; bencoder also takes such structs directly,
+	// e.g. as members of other structs or as vector elements
+	template<typename T> typename detail::bound_entries<
+		typename detail::fields_of<T>::schema>::type bfields(T const& value) {
+		typedef typename detail::fields_of<T>::schema schema;
+		return detail::bind_fields(value, ebb_fields(static_cast<T const*>(NULL)),
+				typename detail::schema_seq<schema>::type());
+	}
+
+	// declares how a struct is bencoded: as a dict of the named members, each
+	// keyed by its name, e.g. EBB_FIELDS(ping, id, t, y) for up to 16 members;
+	// place it at namespace scope in the namespace of the struct
+#define EBB_FIELDS(Type, ...) \
+	inline auto ebb_fields(Type const*) -> decltype(std::make_tuple( \
+			EBB_DETAIL_MAP(EBB_DETAIL_FIELD, Type, __VA_ARGS__))) { \
+		return std::make_tuple(EBB_DETAIL_MAP(EBB_DETAIL_FIELD, Type, __VA_ARGS__)); \
+	}
+#define EBB_DETAIL_FIELD(Type, f) ::ebb::detail::make_field(EBB_KEY(#f), &Type::f)
+#define EBB_DETAIL_EXPAND(x) x
+#define EBB_DETAIL_MAP(m, T, ...) EBB_DETAIL_EXPAND(EBB_DETAIL_PICK(__VA_ARGS__, \
+	EBB_DETAIL_MAP_16, EBB_DETAIL_MAP_15, EBB_DETAIL_MAP_14, EBB_DETAIL_MAP_13, \
+	EBB_DETAIL_MAP_12, EBB_DETAIL_MAP_11, EBB_DETAIL_MAP_10, EBB_DETAIL_MAP_9, \
+	EBB_DETAIL_MAP_8, EBB_DETAIL_MAP_7, EBB_DETAIL_MAP_6, EBB_DETAIL_MAP_5, \
+	EBB_DETAIL_MAP_4, EBB_DETAIL_MAP_3, EBB_DETAIL_MAP_2, EBB_DETAIL_MAP_1)(m, T, __VA_ARGS__))
+#define EBB_DETAIL_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, \
+	_13, _14, _15, _16, N, ...) N
+#define EBB_DETAIL_MAP_1(m, T, f) m(T, f)
+#define EBB_DETAIL_MAP_2(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_1(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_3(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_2(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_4(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_3(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_5(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_4(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_6(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_5(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_7(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_6(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_8(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_7(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_9(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_8(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_10(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_9(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_11(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_10(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_12(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_11(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_13(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_12(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_14(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_13(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_15(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_14(m, T, __VA_ARGS__))
+#define EBB_DETAIL_MAP_16(m, T, f, ...) m(T, f), \
+	EBB_DETAIL_EXPAND(EBB_DETAIL_MAP_15(m, T, __VA_ARGS__))
+
+	namespace detail {
+		// exact number of bytes each argument bencodes to; constexpr for
+		// integers, string literals, std::arrays and tuples of those
+		template<typename T> constexpr typename std::enable_if<
+			is_bencodable_integer<T>::value, size_t>::type bsize(T value) {
+			return 2 + is_negative(value, std::is_signed<typename integer_of<T>::type>())
+				+ count_digits(magnitude(value, is_negative(value,
+								std::is_signed<typename integer_of<T>::type>())));
+		}
+
+		constexpr size_t bsize_string(size_t size) {
+			return count_digits(size) + 1 + size;
+		}
+
+		constexpr size_t bsize(char const* value) {
+			return bsize_string(cstrlen(value));
+		}
+
+		template<size_t N> constexpr size_t bsize(
+				std::array<unsigned char, N> const&) {
+			return bsize_string(N);
+		}
+
+		template<size_t N> constexpr size_t bsize(
+				std::array<const unsigned char, N> const&) {
+			return bsize_string(N);
+		}
+
+		inline size_t bsize(std::vector<unsigned char> const& value) {
+			return bsize_string(value.size());
+		}
+
+		inline size_t bsize(std::vector<char> const& value) {
+			return bsize_string(value.size());
+		}
+
+		inline size_t bsize(std::string const& value) {
+			return bsize_string(value.size());
+		}
+
+		inline size_t bsize(bstring_view const& value) {
+			return bsize_string(value.size());
+		}
+
+		template<char... C> constexpr size_t bsize(bkey<C...> const&) {
+			return bsize_string(sizeof...(C));
+		}
+
+		template<size_t Width> constexpr size_t bsize(bslot<Width> const&) {
+			return bsize_string(Width);
+		}
+
+		constexpr size_t bsize(bencode_token) {
+			return 1;
+		}
+
+		template<typename... TupleTypes> constexpr size_t bsize(
+				std::tuple<TupleTypes...> const& value);
+		template<typename A, typename B> constexpr size_t bsize(
+				std::tuple<A, B> const& entry);
+		template<typename... Entries> constexpr size_t bsize(
+				sorted_entries<Entries...> const& value);
+		template<typename Hasher, typename T> constexpr size_t bsize(
+				hashed<Hasher, T> const& value);
+		template<typename T> size_t bsize(boptional<T> const& value);
+#if __cplusplus >= 201703L
+		template<typename T> size_t bsize(std::optional<T> const& value);
+#endif
+		template<typename T, typename A> size_t bsize(
+				std::vector<T, A> const& value);
+		template<typename Iterator> size_t bsize(
+				iterator_range<Iterator> const& value);
+		template<typename K, typename V, typename C, typename A> size_t bsize(
+				std::map<K, V, C, A> const& value);
+		template<typename K, typename V, typename H, typename E, typename A>
+			size_t bsize(std::unordered_map<K, V, H, E, A> const& value);
+		template<typename Map> size_t bsize(scratch_sorted_map<Map> const& value);
+		inline size_t bsize(bvalue const& value);
+		template<typename T> typename std::enable_if<has_fields<T>::value,
+			size_t>::type bsize(T const& value);
+
+		// sum of the Count sizes starting at First, split in halves so that it
+		// nests only logarithmically deep; every step is its own instantiation
+		// rather than a recursive call, so it still folds into straight-line code
+		template<size_t First, size_t N> constexpr size_t sum_sizes(
+				const size_t (&sizes)[N], std::integral_constant<size_t, 1>) {
+			return sizes[First];
+		}
+
+		template<size_t First, size_t N, size_t Count> constexpr size_t sum_sizes(
+				const size_t (&sizes)[N], std::integral_constant<size_t, Count>) {
+			return sum_sizes<First>(sizes, std::integral_constant<size_t, Count / 2>())
+				+ sum_sizes<First + Count / 2>(sizes,
+						std::integral_constant<size_t, Count - Count / 2>());
+		}
+
+		// the whole pack is expanded at once rather than peeled one by one
+		template<typename... Arguments> constexpr size_t bsize_all(
+				Arguments const&... arguments) {
+			return sum_sizes<0>({bsize(arguments)..., size_t(0)},
+					std::integral_constant<size_t, sizeof...(Arguments) + 1>());
+		}
+
+		template<int... S, typename... TupleTypes> constexpr size_t bsize_tuple(
+				seq<S...>, std::tuple<TupleTypes...> const& value) {
+			return bsize_all(std::get<S>(value)...);
+		}
+
+		template<typename... TupleTypes> constexpr size_t bsize(
+				std::tuple<TupleTypes...> const& value) {
+			return bsize_tuple(typename gen_seq<sizeof...(TupleTypes)>::type(), value);
+		}
+
+		template<typename A, typename B> constexpr size_t bsize(
+				std::tuple<A, B> const& entry) {
+			return is_absent_entry(entry) ? 0 : bsize_tuple(seq<0, 1>(), entry);
+		}
+
+		template<typename... Entries> constexpr size_t bsize(
+				sorted_entries<Entries...> const& value) {
+			return 2 + bsize_tuple(typename gen_seq<sizeof...(Entries)>::type(),
+					value.entries);
+		}
+
+		template<typename Hasher, typename T> constexpr size_t bsize(
+				hashed<Hasher, T> const& value) {
+			return bsize(value.value);
+		}
+
+		template<typename T> size_t bsize(boptional<T> const& value) {
+			return value.has_value() ? bsize(*value) : 0;
+		}
+
+#if __cplusplus >= 201703L
+		template<typename T> size_t bsize(std::optional<T> const& value) {
+			return value.has_value() ? bsize(*value) : 0;
+		}
+#endif
+
+		template<typename Iterator> size_t bsize_elements(Iterator first,
+				Iterator last) {
+			size_t size = 2;
+			for (; first != last; ++first) {
+				size += bsize(*first);
+			}
+			return size;
+		}
+
+		template<typename T, typename A> size_t bsize(
+				std::vector<T, A> const& value) {
+			return bsize_elements(value.begin(), value.end());
+		}
+
+		template<typename Iterator> size_t bsize(
+				iterator_range<Iterator> const& value) {
+			return bsize_elements(value.first, value.last);
+		}
+
+		template<typename Map> size_t bsize_map(Map const& value) {
+			size_t size = 2;
+			for (typename Map::const_iterator it = value.begin(); it != value.end();
+					++it) {
+				size += bsize(it->first) + bsize(it->second);
+			}
+			return size;
+		}
+
+		template<typename K, typename V, typename C, typename A> size_t bsize(
+				std::map<K, V, C, A> const& value) {
+			return bsize_map(value);
+		}
+
+		template<typename K, typename V, typename H, typename E, typename A>
+			size_t bsize(std::unordered_map<K, V, H, E, A> const& value) {
+			return bsize_map(value);
+		}
+
+		template<typename Map> size_t bsize(scratch_sorted_map<Map> const& value) {
+			return bsize_map(*value.map);
+		}
+
+		template<typename T> typename std::enable_if<has_fields<T>::value,
+			size_t>::type bsize(T const& value) {
+			return bsize(bfields(value));
+		}
+
+		inline size_t bsize(bvalue const& value) {
+			switch (value.type()) {
+				case btype::integer:
+					return value.is_int64() ? bsize(value.integer())
+						: bsize(value.uinteger());
+				case btype::string:
+					return bsize(value.string());
+				default:
+					return bsize_elements(value.begin(), value.end());
+			}
+		}
+	}
+
+	// exact number of bytes bencoder would write for the same arguments; a
+	// constant expression when every leaf is an integer, a string literal or an
+	// std::array (evaluating tuples at compile time needs C++14)
+	template<typename... Arguments> constexpr size_t bencoded_size(
+			Arguments const&... arguments) {
+		return detail::bsize_all(arguments...);
+	}
+
+	namespace detail {
+		// writes "i<value>e" and returns its length; out must have room for 22
+		inline size_t format_integer(unsigned char* out, bool negative,
+				std::uint64_t magnitude) {
+			size_t written = count_digits(magnitude) + negative + 2;
+			out[0] = 'i';
+			if (negative) {
+				out[1] = '-';
+			}
+			format_digits(out + written - 1, magnitude);
+			out[written - 1] = 'e';
+			return written;
+		}
+
+		// writes "<size>:" and returns its length; out must have room for 21
+		inline size_t format_length(unsigned char* out, size_t size) {
+			size_t digits = count_digits(size);
+			format_digits(out + digits, size);
+			out[digits] = ':';
+			return digits + 1;
+		}
+
+		// walks the bencodable arguments and hands every token to Derived, which
+		// provides put_token(), put_integer() and put_string(); shared by bencoder
+		// and bsink_encoder so that both accept exactly the same expressions
+		template<typename Derived> class bencoder_base {
+			protected:
+				// encodes each argument in turn, stopping at the first that fails; the
+				// whole pack of a level is expanded at once, so a dict of n entries
+				// costs one instantiation rather than a chain of n nested ones
+				template<typename... Arguments> bool bencode(Arguments&&... arguments) {
+					bool ok = true;
+					const bool expanded[] = {true, (ok = ok && bencode_one(arguments))...};
+					(void)expanded;
+					return ok;
+				}
+
+			private:
+				template<typename T> typename std::enable_if<
+					is_bencodable_integer<T>::value, bool>::type bencode_one(T value) {
+					bool negative = is_negative(value,
+							std::is_signed<typename integer_of<T>::type>());
+					return derived().put_integer(negative, magnitude(value, negative));
+				}
+
+				// char pointers only; string literals take the overload below, which is
+				// instantiated per length and small enough to inline, so that their
+				// strlen() folds away
+				template<typename T> typename std::enable_if<
+					std::is_same<T, char const*>::value || std::is_same<T, char*>::value,
+					bool>::type bencode_one(T const& value) {
+					return derived().put_string(
+							reinterpret_cast<const unsigned char*>(value), strlen(value));
+				}
+
+				template<size_t N> bool bencode_one(char const (&value)[N]) {
+					return derived().put_string(
+							reinterpret_cast<const unsigned char*>(value), strlen(value));
+				}
+
+				bool bencode_one(std::vector<unsigned char> const &value) {
+					return bencode_listish(value);
+				}
+
+				bool bencode_one(std::vector<char> const &value) {
+					return bencode_listish(value);
+				}
+
+				bool bencode_one(std::string const &value) {
+					return bencode_listish(value);
+				}
+
+				template<size_t N> bool bencode_one(
+						std::array<const unsigned char, N> const &value) {
+					return bencode_listish(value);
+				}
+
+				template<size_t N> bool bencode_one(
+						std::array<unsigned char, N> const &value) {
+					return bencode_listish(value);
+				}
+
+				bool bencode_one(bstring_view const &value) {
+					return bencode_listish(value);
+				}
+
+				bool bencode_one(bencode_token const value) {
+					return derived().put_token(value.token);
+				}
+
+				template<char... C> bool bencode_one(bkey<C...> const&) {
+					return derived().put_string(bkey<C...>::data, sizeof...(C));
+				}
+
+				template<typename... A, typename... B> bool bencode_one(
+						sorted_entries<std::tuple<A, B>...> const &value) {
+					return derived().put_token('d')
+						&& bencode_sorted(value.entries,
+								all_static_keys<typename std::decay<A>::type...>(),
+								typename gen_seq<sizeof...(A)>::type())
+						&& derived().put_token('e');
+				}
+
+				template<typename Hasher, typename T> bool bencode_one(
+						hashed<Hasher, T> const &value) {
+					return derived().bencode_hashed(*value.hasher, value.value);
+				}
+
+				template<size_t Width> bool bencode_one(bslot<Width>& slot) {
+					return derived().put_slot(slot.offset, Width);
+				}
+
+				template<typename... TupleTypes> bool bencode_one(
+						std::tuple<TupleTypes...> const &value) {
+					return bencode_tuple(value,
+							typename gen_seq<sizeof...(TupleTypes)>::type());
+				}
+
+				template<typename... TupleTypes, int... S> bool bencode_tuple(
+						std::tuple<TupleTypes...> const &value, seq<S...>) {
+					return bencode(std::get<S>(value)...);
+				}
+
+				// a k_v entry, skipped if its value is an absent optional
+				template<typename A, typename B> bool bencode_one(
+						std::tuple<A, B> const &entry) {
+					return is_absent_entry(entry) || (bencode_one(std::get<0>(entry))
+							&& bencode_one(std::get<1>(entry)));
+				}
+
+				template<typename T> bool bencode_one(boptional<T> const &value) {
+					return !value.has_value() || bencode_one(*value);
+				}
+
+#if __cplusplus >= 201703L
+				template<typename T> bool bencode_one(std::optional<T> const &value) {
+					return !value.has_value() || bencode_one(*value);
+				}
+#endif
+
+				template<typename T, typename A> bool bencode_one(
+						std::vector<T, A> const &value) {
+					return bencode_elements(value.begin(), value.end());
+				}
+
+				template<typename Iterator> bool bencode_one(
+						iterator_range<Iterator> const &value) {
+					return bencode_elements(value.first, value.last);
+				}
+
+				template<typename K, typename V, typename C, typename A> bool bencode_one(
+						std::map<K, V, C, A> const &value) {
+					return bencode_map(value,
+							is_canonically_ordered<std::map<K, V, C, A>>());
+				}
+
+				template<typename K, typename V, typename H, typename E, typename A>
+					bool bencode_one(std::unordered_map<K, V, H, E, A> const &value) {
+					return bencode_map(value, std::false_type());
+				}
+
+				template<typename Map> bool bencode_one(
+						scratch_sorted_map<Map> const &value) {
+					if (value.capacity < value.map->size()) {
+						return bencode_map(*value.map, std::false_type());
+					}
+					entry_emitter emit = {this};
+					return derived().put_token('d')
+						&& emit_sorted(*value.map, emit, value.scratch)
+						&& derived().put_token('e');
+				}
+
+				bool bencode_one(bvalue const &value) {
+					return bencode_value(value);
+				}
+
+				template<typename T> typename std::enable_if<has_fields<T>::value,
+					bool>::type bencode_one(T const &value) {
+					return bencode_one(bfields(value));
+				}
+
+				Derived& derived() {
+					return static_cast<Derived&>(*this);
+				}
+
+				template<typename Iterator> bool bencode_elements(Iterator first,
+						Iterator last) {
+					if (!derived().put_token('l')) {
+						return false;
+					}
+					for (; first != last; ++first) {
+						if (!bencode(*first)) {
+							return false;
+						}
+					}
+					return derived().put_token('e');
+				}
+
+				// all keys are EBB_KEYs, so the order is known at compile time
+				template<typename... A, typename... B, int... S> bool bencode_sorted(
+						std::tuple<std::tuple<A, B>...> const& entries, std::true_type,
+						seq<S...>) {
+					return bencode_in_order(entries, typename static_key_order<
+							typename std::decay<A>::type...>::type());
+				}
+
+				template<typename Entries, int... S> bool bencode_in_order(
+						Entries const& entries, seq<S...>) {
+					return bencode(std::get<S>(entries)...);
+				}
+
+				// sorts the entry positions by key on the stack, then emits each
+				// entry through a table indexed by position
+				template<typename... A, typename... B, int... S> bool bencode_sorted(
+						std::tuple<std::tuple<A, B>...> const& entries, std::false_type,
+						seq<S...>) {
+					typedef std::tuple<std::tuple<A, B>...> entries_type;
+					typedef bool (bencoder_base::*emitter)(entries_type const&);
+					static const emitter emitters[] = {
+						&bencoder_base::template bencode_entry<S, entries_type>...};
+					const size_t n = sizeof...(S);
+					const bstring_view keys[n] = {
+						key_bytes(std::get<0>(std::get<S>(entries)))...};
+					// entries whose value is an absent optional are not written, so
+					// they neither take part in the order nor count as duplicates
+					const bool absent[n] = {is_absent_entry(std::get<S>(entries))...};
+					size_t order[n];
+					size_t present = 0;
+					for (size_t position = 0; position < n; position++) {
+						if (absent[position]) {
+							continue;
+						}
+						size_t j = present++;
+						for (; j && key_less(keys[position], keys[order[j - 1]]); j--) {
+							order[j] = order[j - 1];
+						}
+						order[j] = position;
+						if (j && keys[position] == keys[order[j - 1]]) {
+							return false;
+						}
+						if (j + 1 < present && keys[position] == keys[order[j + 1]]) {
+							return false;
+						}
+					}
+					for (size_t i = 0; i < present; i++) {
+						if (!(this->*emitters[order[i]])(entries)) {
+							return false;
+						}
+					}
+					return true;
+				}
+
+				template<int I, typename Entries> bool bencode_entry(
+						Entries const& entries) {
+					return bencode(std::get<I>(entries));
+				}
+
+				// emits one map entry; used as the callback of for_each_sorted
+				struct entry_emitter {
+					bencoder_base* self;
+					template<typename Entry> bool operator()(Entry const& entry) const {
+						return self->bencode(entry.first, entry.second);
+					}
+				};
+
+				bool bencode_value(bvalue const& value) {
+					switch (value.type()) {
+						case btype::integer:
+							return value.is_int64() ? bencode(value.integer())
+								: bencode(value.uinteger());
+						case btype::string:
+							return bencode(value.string());
+						default:
+							if (!derived().put_token(value.is_list() ? 'l' : 'd')) {
+								return false;
+							}
+							for (const bvalue* it = value.begin(); it != value.end(); ++it) {
+								if (!bencode_value(*it)) {
+									return false;
+								}
+							}
+							return derived().put_token('e');
+					}
+				}
+
+				template<typename Map> bool bencode_map(Map const& value,
+						std::true_type) {
+					if (!derived().put_token('d')) {
+						return false;
+					}
+					for (typename Map::const_iterator it = value.begin();
+							it != value.end(); ++it) {
+						if (!bencode(it->first, it->second)) {
+							return false;
+						}
+					}
+					return derived().put_token('e');
+				}
+
+				template<typename Map> bool bencode_map(Map const& value,
+						std::false_type) {
+					entry_emitter emit = {this};
+					return derived().put_token('d') && for_each_sorted(value, emit)
+						&& derived().put_token('e');
+				}
+
+				template<typename T> bool bencode_listish(T const& value) {
+					return derived().put_string(
+							reinterpret_cast<const unsigned char*>(value.data()), value.size());
+				}
+		};
+	}
+
+	class bencoder : private detail::bencoder_base<bencoder> {
+		friend class detail::bencoder_base<bencoder>;
+		private:
+			unsigned char* buffer;
+			size_t len;
+			unsigned char* const start;
+			size_t required;
+		public:
+			bencoder(unsigned char* buffer, size_t len) : buffer(buffer), len(len),
+				start(buffer), required(0) {};
+			template<size_t Size> bencoder(std::array<unsigned char, Size>& buffer) :
+				buffer(buffer.data()), len(buffer.size()), start(buffer.data()),
+				required(0) {};
+			template<typename... Arguments> unsigned char* operator()
+				(Arguments&&... remaining) {
+					assert(buffer);
+					size_t written = buffer - start;
+					size_t available = len;
+					if (!bencode(remaining...)) {
+						buffer = NULL;
+						// a failure with room to spare, e.g. a duplicate key in a
+						// bsorted_dict, is not an overflow and more room would not help
+						size_t size = bencoded_size(remaining...);
+						required = size > available ? written + size : 0;
+					}
+					return buffer;
+				}
+
+			// total number of bytes written so far, or after an overflow, the
+			// buffer size that everything passed to this bencoder would have needed;
+			// 0 after a failure other than an overflow
+			size_t needed() const {
+				return buffer ? buffer - start : required;
+			}
+
+		private:
+			bool put_token(unsigned char token) {
+				if (len == 0) {
+					return false;
+				}
+				*buffer = token;
+				buffer++;
+				len--;
+				return true;
+			}
+
+			bool put_integer(bool negative, std::uint64_t magnitude) {
+				if (detail::count_digits(magnitude) + negative + 2 > len) {
+					return false;
+				}
+				size_t written = detail::format_integer(buffer, negative, magnitude);
+				buffer += written;
+				len -= written;
+				return true;
+			}
+
+			// the bytes of value are contiguous in the buffer, so they are hashed in
+			// one go right after being written, while still in cache
+			template<typename Hasher, typename T> bool bencode_hashed(Hasher& hasher,
+					T const& value) {
+				unsigned char* first = buffer;
+				if (!bencode(value)) {
+					return false;
+				}
+				hasher.update(first, buffer - first);
+				return true;
+			}
+
+			// zero-filled string whose payload offset is recorded for patching
+			bool put_slot(size_t& offset, size_t size) {
+				size_t digits = detail::count_digits(size);
+				if (size >= len || digits + 1 > len - size) {
+					return false;
+				}
+				detail::format_length(buffer, size);
+				std::memset(buffer + digits + 1, 0, size);
+				offset = buffer + digits + 1 - start;
+				buffer += digits + 1 + size;
+				len -= digits + 1 + size;
+				return true;
+			}
+
+			// length prefix and payload, with a single bounds check up front
+			bool put_string(const unsigned char* value, size_t size) {
+				size_t digits = detail::count_digits(size);
+				if (size >= len || digits + 1 > len - size) {
+					return false;
+				}
+				detail::format_length(buffer, size);
+				if (size) {
+					std::memcpy(buffer + digits + 1, value, size);
+				}
+				buffer += digits + 1 + size;
+				len -= digits + 1 + size;
+				return true;
+			}
+	};
+
+	// a message encoded once, with bslots for its variable fields; every copy
+	// is a memcpy followed by patching the slots, e.g.
+	//   bslot<2> t;
+	//   btemplate<64> ping;
+	//   ping.compile(bdict(k_v("q", "ping"), k_v("t", t), k_v("y", "q")));
+	//   unsigned char* last = ping(packet, sizeof(packet));
+	//   t.patch(packet, transaction_id);
+	template<size_t Capacity> class btemplate {
+		private:
+			std::array<unsigned char, Capacity> bytes;
+			size_t len;
+		public:
+			btemplate() : len(0) {};
+
+			// encodes the message, recording the offsets of the bslots in it;
+			// returns false if it does not fit in Capacity
+			template<typename... Arguments> bool compile(Arguments&&... arguments) {
+				unsigned char* last = bencoder(bytes)(arguments...);
+				len = last ? last - bytes.data() : 0;
+				return last != NULL;
+			}
+
+			// copies the message to output, returning a pointer just past it or
+			// NULL if it does not fit
+			unsigned char* operator()(unsigned char* output, size_t output_len) const {
+				if (len > output_len) {
+					return NULL;
+				}
+				std::memcpy(output, bytes.data(), len);
+				return output + len;
+			}
+
+			const unsigned char* data() const { return bytes.data(); }
+			size_t size() const { return len; }
+	};
+
+	// where one message of a bbatch starts in its buffer and how long it is
+	struct bslice {
+		size_t offset;
+		size_t length;
+	};
+
+	// runs task(0) to task(workers - 1), workers > 0, on as many threads, the
+	// calling one included, and waits for all of them; the threads are created
+	// and joined on every call, which costs about as much as encoding a few
+	// hundred small messages, so callers running many small batches should
+	// pass a thread pool with the same call operator instead
+	struct bthreads {
+		template<typename Task> void operator()(size_t workers, Task const& task) const {
+			joiner threads;
+			threads.reserve(workers - 1);
+			for (size_t worker = 1; worker < workers; worker++) {
+				threads.emplace_back(std::cref(task), worker);
+			}
+			task(0);
+		}
+
+		private:
+			// joins the threads started so far when it goes out of scope, also
+			// when starting a thread or task(0) throws, as destroying a joinable
+			// thread would terminate the process
+			struct joiner : std::vector<std::thread> {
+				~joiner() {
+					for (size_t i = 0; i < size(); i++) {
+						(*this)[i].join();
+					}
+				}
+			};
+	};
+
+	namespace detail {
+		// the encode callable handed to a bbatch generator in its sizing pass
+		struct batch_sizer {
+			size_t size;
+			template<typename... Arguments> bool operator()(Arguments&&... arguments) {
+				size = bencoded_size(arguments...);
+				return true;
+			}
+		};
+
+		// the encode callable handed to a bbatch generator to write a message
+		struct batch_writer {
+			unsigned char* output;
+			size_t output_len;
+			unsigned char* last;
+			template<typename... Arguments> bool operator()(Arguments&&... arguments) {
+				last = bencoder(output, output_len)(arguments...);
+				return last != NULL;
+			}
+		};
+	}
+
+	// packs messages back to back into one caller supplied buffer, recording
+	// each one's offset and length in a table, e.g. to send a burst of
+	// responses with a single sendmmsg(). Messages are appended one at a time
+	// with operator(), or n at a time from a generator which is called as
+	// generate(i, encode) and returns encode(...) with the arguments of message
+	// i; append_parallel() calls it twice per message, first to size it and
+	// then to encode it, so it has to produce the same message both times
+	class bbatch {
+		private:
+			unsigned char* buffer;
+			size_t capacity;
+			bslice* table;
+			size_t max_messages;
+			size_t count;
+			size_t used;
+			size_t required;
+		public:
+			// fewest messages append_parallel() hands to one worker; smaller
+			// batches use fewer workers, and one that would use only a single
+			// worker is encoded on the calling thread without the executor
+			static const size_t parallel_grain = 256;
+
+			bbatch(unsigned char* buffer, size_t capacity, bslice* slices,
+					size_t max_messages) : buffer(buffer), capacity(capacity),
+				table(slices), max_messages(max_messages), count(0), used(0),
+				required(0) {};
+
+			// appends one message; returns false, leaving the batch as it was, if
+			// the buffer or the table is full
+			template<typename... Arguments> bool operator()(Arguments&&... arguments) {
+				detail::batch_writer write = {buffer + used, capacity - used, NULL};
+				return count < max_messages && append_written(write(arguments...),
+						write);
+			}
+
+			// appends messages 0 to n - 1 of generate, stopping at the first one
+			// that does not fit
+			template<typename Generate> bool append(size_t n, Generate generate) {
+				for (size_t i = 0; i < n; i++) {
+					detail::batch_writer write = {buffer + used, capacity - used, NULL};
+					if (count == max_messages
+							|| !append_written(generate(i, write), write)) {
+						return false;
+					}
+				}
+				return true;
+			}
+
+			// appends messages 0 to n - 1 of generate, split into contiguous runs
+			// over workers threads; their exact sizes are worked out first, so
+			// each message is encoded straight into its final position without
+			// any locking. Each worker gets at least parallel_grain messages. On
+			// failure nothing is appended, and needed() tells how many bytes the
+			// whole batch requires if it did not fit
+			template<typename Generate, typename Executor = bthreads>
+				bool append_parallel(size_t n, Generate const& generate, size_t workers,
+						Executor const& run = Executor()) {
+				if (n > max_messages - count) {
+					return false;
+				}
+				if (workers > n / parallel_grain) {
+					workers = n / parallel_grain;
+				}
+				if (!workers) {
+					workers = 1;
+				}
+				bslice* slices = table + count;
+				std::atomic<bool> failed(false);
+				dispatch(run, workers, [&](size_t worker) {
+					for (size_t i = n * worker / workers, last = n * (worker + 1) / workers;
+							i < last; i++) {
+						detail::batch_sizer size = {0};
+						if (!generate(i, size)) {
+							failed = true;
+							return;
+						}
+						slices[i].length = size.size;
+					}
+				});
+				if (failed) {
+					return false;
+				}
+				size_t offset = used;
+				for (size_t i = 0; i < n; i++) {
+					slices[i].offset = offset;
+					offset += slices[i].length;
+				}
+				if (offset > capacity) {
+					required = offset;
+					return false;
+				}
+				dispatch(run, workers, [&](size_t worker) {
+					for (size_t i = n * worker / workers, last = n * (worker + 1) / workers;
+							i < last; i++) {
+						detail::batch_writer write = {buffer + slices[i].offset,
+							slices[i].length, NULL};
+						if (!generate(i, write)
+								|| write.last != buffer + slices[i].offset + slices[i].length) {
+							failed = true;
+							return;
+						}
+					}
+				});
+				if (failed) {
+					return false;
+				}
+				count += n;
+				used = offset;
+				return true;
+			}
+
+			// number of messages
+			size_t size() const { return count; }
+			// total length of all messages
+			size_t bytes() const { return used; }
+			const unsigned char* data() const { return buffer; }
+			const bslice* slices() const { return table; }
+
+			bstring_view operator[](size_t i) const {
+				assert(i < count);
+				return bstring_view(buffer + table[i].offset, table[i].length);
+			}
+
+			// bytes the last failed append_parallel() would have needed in all
+			size_t needed() const { return required; }
+
+			void clear() {
+				count = 0;
+				used = 0;
+			}
+
+#ifndef _WIN32
+			// points iov[i] at message i, e.g. for the msg_iov of an mmsghdr
+			void fill(struct iovec* iov) const {
+				for (size_t i = 0; i < count; i++) {
+					iov[i].iov_base = buffer + table[i].offset;
+					iov[i].iov_len = table[i].length;
+				}
+			}
+#endif
+
+		private:
+			bool append_written(bool written, detail::batch_writer const& write) {
+				if (!written) {
+					return false;
+				}
+				table[count].offset = used;
+				table[count].length = write.last - write.output;
+				count++;
+				used += table[count - 1].length;
+				return true;
+			}
+
+			// a single worker runs on the calling thread
+			template<typename Executor, typename Task> static void dispatch(
+					Executor const& run, size_t workers, Task const& task) {
+				if (workers == 1) {
+					task(0);
+				} else {
+					run(workers, task);
+				}
+			}
+	};
+
+	// encodes into a Sink instead of a single contiguous buffer; a Sink provides
+	//   bool write(const unsigned char* data, size_t size)
+	//     for token bytes that are only valid for the duration of the call, and
+	//   bool write_ref(const unsigned char* data, size_t size)
+	//     for string payloads, which stay valid for as long as the encoded
+	//     arguments do and so may be referenced instead of copied.
+	// Output can be produced over any number of calls, each continuing where
+	// the previous one stopped.
+	template<typename Sink> class bsink_encoder
+		: private detail::bencoder_base<bsink_encoder<Sink>> {
+		friend class detail::bencoder_base<bsink_encoder<Sink>>;
+		private:
+			Sink& sink;
+			detail::hash_tap* taps;
+		public:
+			explicit bsink_encoder(Sink& sink) : sink(sink), taps(NULL) {};
+			template<typename... Arguments> bool operator()(Arguments&&... remaining) {
+				return this->bencode(remaining...);
+			}
+
+		private:
+			bool put_token(unsigned char token) {
+				return write(&token, 1);
+			}
+
+			bool put_integer(bool negative, std::uint64_t magnitude) {
+				unsigned char header[22];
+				return write(header, detail::format_integer(header, negative, magnitude));
+			}
+
+			bool put_string(const unsigned char* value, size_t size) {
+				unsigned char header[21];
+				if (!write(header, detail::format_length(header, size))) {
+					return false;
+				}
+				tap(value, size);
+				return sink.write_ref(value, size);
+			}
+
+			bool write(const unsigned char* data, size_t size) {
+				tap(data, size);
+				return sink.write(data, size);
+			}
+
+			void tap(const unsigned char* data, size_t size) {
+				for (detail::hash_tap* t = taps; t; t = t->next) {
+					t->update(t->hasher, data, size);
+				}
+			}
+
+			// the output is not retained, so hashers see it as it goes by
+			template<typename Hasher, typename T> bool bencode_hashed(Hasher& hasher,
+					T const& value) {
+				detail::hash_tap t = {&detail::update_hasher<Hasher>, &hasher, taps};
+				taps = &t;
+				bool ok = this->bencode(value);
+				taps = t.next;
+				return ok;
+			}
+	};
+
+	template<typename Sink, typename... Arguments> bool bencode_to(Sink& sink,
+			Arguments&&... arguments) {
+		return bsink_encoder<Sink>(sink)(arguments...);
+	}
+
+	// hands every piece of output to a callable taking (const unsigned char*,
+	// size_t) and returning false to abort
+	template<typename Callback> class bcallback_sink {
+		private:
+			Callback callback;
+		public:
+			explicit bcallback_sink(Callback callback) : callback(callback) {};
+			bool write(const unsigned char* data, size_t size) {
+				return callback(data, size);
+			}
+			bool write_ref(const unsigned char* data, size_t size) {
+				return callback(data, size);
+			}
+	};
+
+	template<typename Callback> bcallback_sink<Callback> make_bcallback_sink(
+			Callback callback) {
+		return bcallback_sink<Callback>(callback);
+	}
+
+	// discards the output after feeding it to a hasher, to compute e.g. an
+	// info-hash without keeping the encoded info dict around
+	template<typename Hasher> class bhash_sink {
+		private:
+			Hasher& hasher;
+		public:
+			explicit bhash_sink(Hasher& hasher) : hasher(hasher) {};
+			bool write(const unsigned char* data, size_t size) {
+				hasher.update(data, size);
+				return true;
+			}
+			bool write_ref(const unsigned char* data, size_t size) {
+				hasher.update(data, size);
+				return true;
+			}
+	};
+
+	// a fixed-size piece of a chunk chain; data and capacity are set by whoever
+	// hands the chunk out, size and next by bchunk_sink
+	struct bchunk {
+		unsigned char* data;
+		size_t capacity;
+		size_t size;
+		bchunk* next;
+	};
+
+	// fills a chain of fixed-size chunks, e.g. from a buffer pool, obtaining a
+	// new one from a callable returning bchunk* (or NULL when exhausted) each
+	// time the last one is full; payloads are split across chunk boundaries
+	template<typename Allocate> class bchunk_sink {
+		private:
+			Allocate allocate;
+			bchunk* first;
+			bchunk* last;
+		public:
+			explicit bchunk_sink(Allocate allocate) : allocate(allocate), first(NULL),
+				last(NULL) {};
+
+			bool write(const unsigned char* data, size_t size) {
+				while (size) {
+					if (!last || last->size == last->capacity) {
+						bchunk* chunk = allocate();
+						if (!chunk || !chunk->capacity) {
+							return false;
+						}
+						chunk->size = 0;
+						chunk->next = NULL;
+						(last ? last->next : first) = chunk;
+						last = chunk;
+					}
+					size_t n = std::min(size, last->capacity - last->size);
+					std::memcpy(last->data + last->size, data, n);
+					last->size += n;
+					data += n;
+					size -= n;
+				}
+				return true;
+			}
+			bool write_ref(const unsigned char* data, size_t size) {
+				return write(data, size);
+			}
+
+			// the first chunk of the chain, or NULL if nothing was written
+			bchunk* chain() const { return first; }
+	};
+
+	template<typename Allocate> bchunk_sink<Allocate> make_bchunk_sink(
+			Allocate allocate) {
+		return bchunk_sink<Allocate>(allocate);
+	}
+
+#ifndef _WIN32
+	// writes to a blocking file descriptor through a caller supplied staging
+	// buffer; payloads that do not fit in it are written directly, and flush()
+	// has to be called once encoding is done
+	class bfd_sink {
+		private:
+			int fd;
+			unsigned char* buffer;
+			size_t len;
+			size_t used;
+		public:
+			bfd_sink(int fd, unsigned char* buffer, size_t len) : fd(fd),
+				buffer(buffer), len(len), used(0) {};
+			template<size_t Size> bfd_sink(int fd,
+					std::array<unsigned char, Size>& buffer) :
+				bfd_sink(fd, buffer.data(), buffer.size()) {};
+
+			bool write(const unsigned char* data, size_t size) {
+				if (size > len - used && !flush()) {
+					return false;
+				}
+				if (size > len) {
+					return write_all(data, size);
+				}
+				if (size) {
+					std::memcpy(buffer + used, data, size);
+				}
+				used += size;
+				return true;
+			}
+			bool write_ref(const unsigned char* data, size_t size) {
+				return write(data, size);
+			}
+
+			bool flush() {
+				bool ok = write_all(buffer, used);
+				used = 0;
+				return ok;
+			}
+
+		private:
+			bool write_all(const unsigned char* data, size_t size) {
+				while (size) {
+					ssize_t written = ::write(fd, data, size);
+					if (written < 0) {
+						if (errno == EINTR) {
+							continue;
+						}
+						return false;
+					}
+					data += written;
+					size -= written;
+				}
+				return true;
+			}
+	};
+
+	// gathers output into a struct iovec array for writev() or sendmsg(); token
+	// bytes and payloads shorter than threshold are copied into a caller
+	// supplied scratch buffer, longer payloads are referenced in place
+	class biovec_sink {
+		private:
+			struct iovec* iov;
+			size_t iov_capacity;
+			size_t iov_count;
+			unsigned char* scratch;
+			size_t scratch_len;
+			size_t scratch_used;
+			size_t threshold;
+		public:
+			biovec_sink(struct iovec* iov, size_t iov_capacity, unsigned char* scratch,
+					size_t scratch_len, size_t threshold = 64) : iov(iov),
+				iov_capacity(iov_capacity), iov_count(0), scratch(scratch),
+				scratch_len(scratch_len), scratch_used(0), threshold(threshold) {};
+
+			bool write(const unsigned char* data, size_t size) {
+				if (size > scratch_len - scratch_used) {
+					return false;
+				}
+				unsigned char* tail = scratch + scratch_used;
+				if (size) {
+					std::memcpy(tail, data, size);
+				}
+				scratch_used += size;
+				// grow the last entry if it already ends where this copy starts
+				if (iov_count && static_cast<unsigned char*>(iov[iov_count - 1].iov_base)
+						+ iov[iov_count - 1].iov_len == tail) {
+					iov[iov_count - 1].iov_len += size;
+					return true;
+				}
+				return append(tail, size);
+			}
+			bool write_ref(const unsigned char* data, size_t size) {
+				if (size < threshold) {
+					return write(data, size);
+				}
+				return append(data, size);
+			}
+
+			const struct iovec* data() const { return iov; }
+			// number of iovec entries filled in
+			size_t size() const { return iov_count; }
+
+			void clear() {
+				iov_count = 0;
+				scratch_used = 0;
+			}
+
+		private:
+			bool append(const unsigned char* data, size_t size) {
+				if (iov_count == iov_capacity) {
+					return false;
+				}
+				iov[iov_count].iov_base = const_cast<unsigned char*>(data);
+				iov[iov_count].iov_len = size;
+				iov_count++;
+				return true;
+			}
+	};
+#endif
+
+	// the kinds of values a bdecoder can produce
+	// one entry of the flat token array filled in by bdecoder; a list or dict
+	// token is immediately followed by the tokens of its elements (for a dict,
+	// alternating keys and values), and 'next' is the index of the first token
+	// after the whole subtree, so siblings can be walked without recursion
+	struct btoken {
+		std::uint32_t offset; // string payload, integer digits or 'l'/'d'
+		std::uint32_t length; // string bytes, integer chars, list or dict entries
+		std::uint32_t next;
+		btype type;
+	};
+
+	namespace detail {
+		const static std::uint32_t no_token = UINT32_MAX;
+
+		// parses the digits of a bencoded integer up to (but not including) its
+		// terminating 'e'; returns NULL on malformed input or int64 overflow
+		inline const unsigned char* parse_integer(const unsigned char* p,
+				const unsigned char* end, std::int64_t& value) {
+			bool negative = p != end && *p == '-';
+			if (negative) {
+				p++;
+			}
+			if (p == end || *p < '0' || *p > '9') {
+				return NULL;
+			}
+			const std::uint64_t limit = negative ? std::uint64_t(INT64_MAX) + 1
+				: std::uint64_t(INT64_MAX);
+			std::uint64_t magnitude = 0;
+			for (; p != end && *p >= '0' && *p <= '9'; p++) {
+				unsigned digit = *p - '0';
+				if (magnitude > (limit - digit) / 10) {
+					return NULL;
+				}
+				magnitude = magnitude * 10 + digit;
+			}
+			if (p == end || *p != 'e') {
+				return NULL;
+			}
+			value = negative ? std::int64_t(0 - magnitude) : std::int64_t(magnitude);
+			return p;
+		}
+
+		// parses a string length prefix up to and including its ':'; returns
+		// NULL if it is malformed, has leading zeros or the payload would run
+		// past end
+		inline const unsigned char* parse_length(const unsigned char* p,
+				const unsigned char* end, size_t& length) {
+			size_t value = 0;
+			const unsigned char* digits = p;
+			for (; p != end && *p >= '0' && *p <= '9'; p++) {
+				value = value * 10 + (*p - '0');
+				if (value > size_t(end - digits)) {
+					return NULL;
+				}
+			}
+			if (p == digits || p == end || *p != ':'
+					|| (*digits == '0' && p - digits > 1)) {
+				return NULL;
+			}
+			p++;
+			if (value > size_t(end - p)) {
+				return NULL;
+			}
+			length = value;
+			return p;
+		}
+
+		// whether string token a sorts strictly before string token b, comparing
+		// raw bytes as canonical bencode orders dict keys
+		inline bool key_precedes(const unsigned char* source, btoken const& a,
+				btoken const& b) {
+			int order = std::memcmp(source + a.offset, source + b.offset,
+					a.length < b.length ? a.length : b.length);
+			return order < 0 || (order == 0 && a.length < b.length);
+		}
+	}
+
+	// view of a single decoded value; cheap to copy, and only valid for as long
+	// as both the source buffer and the token array of its bdecoder are
+	class bview {
+		private:
+			const unsigned char* source;
+			const btoken* tokens;
+			std::uint32_t index;
+		public:
+			// iterates over the elements of a list, or the alternating keys and
+			// values of a dict
+			class iterator {
+				private:
+					const unsigned char* source;
+					const btoken* tokens;
+					std::uint32_t index;
+				public:
+					iterator(const unsigned char* source, const btoken* tokens,
+							std::uint32_t index) : source(source), tokens(tokens),
+						index(index) {};
+					bview operator*() const { return bview(source, tokens, index); }
+					iterator& operator++() {
+						index = tokens[index].next;
+						return *this;
+					}
+					bool operator==(iterator const& other) const {
+						return index == other.index;
+					}
+					bool operator!=(iterator const& other) const {
+						return index != other.index;
+					}
+			};
+
+			bview() : source(NULL), tokens(NULL), index(detail::no_token) {};
+			bview(const unsigned char* source, const btoken* tokens,
+					std::uint32_t index) : source(source), tokens(tokens),
+				index(index) {};
+
+			// false for the value returned by a failed lookup; every accessor is
+			// safe on such an empty view and on a view of the wrong type: lookups
+			// return empty views again, integer() is 0, string() and raw() are
+			// empty, size() is 0 and begin() == end(), so that lookups can be
+			// chained through untrusted input and checked once at the end
+			explicit operator bool() const { return tokens != NULL; }
+			// an empty view has no type and reports btype::integer
+			btype type() const { return tokens ? token().type : btype::integer; }
+			bool is_integer() const { return tokens && token().type == btype::integer; }
+			bool is_string() const { return tokens && token().type == btype::string; }
+			bool is_list() const { return tokens && token().type == btype::list; }
+			bool is_dict() const { return tokens && token().type == btype::dict; }
+
+			// the integer is parsed straight from the source buffer on each call
+			std::int64_t integer() const {
+				std::int64_t value = 0;
+				if (!is_integer()) {
+					return value;
+				}
+				const unsigned char* digits = source + token().offset;
+				detail::parse_integer(digits, digits + token().length + 1, value);
+				return value;
+			}
+
+			bstring_view string() const {
+				if (!is_string()) {
+					return bstring_view();
+				}
+				return bstring_view(source + token().offset, token().length);
+			}
+
+			// number of list elements or dict entries
+			size_t size() const {
+				return is_list() || is_dict() ? token().length : 0;
+			}
+
+			// the raw bencoded bytes of this value, e.g. for hashing an info dict
+			bstring_view raw() const {
+				if (!tokens) {
+					return bstring_view();
+				}
+				const btoken& t = token();
+				const unsigned char* first = source + t.offset;
+				if (t.type == btype::string) {
+					for (size_t n = t.length; n; n /= 10) {
+						first--;
+					}
+					first -= t.length ? 1 : 2;
+				} else if (t.type == btype::integer) {
+					first--;
+				}
+				// the 'e' closing a container directly follows its last element, so
+				// descend through last elements until reaching a scalar or an empty
+				// container
+				size_t closers = 0;
+				std::uint32_t i = index;
+				while (tokens[i].type == btype::list || tokens[i].type == btype::dict) {
+					closers++;
+					if (tokens[i].next == i + 1) {
+						break;
+					}
+					std::uint32_t child = i + 1;
+					while (tokens[child].next != tokens[i].next) {
+						child = tokens[child].next;
+					}
+					i = child;
+				}
+				const btoken& last = tokens[i];
+				const unsigned char* end = source + last.offset;
+				switch (last.type) {
+					case btype::integer:
+						end += last.length + 1;
+						break;
+					case btype::string:
+						end += last.length;
+						break;
+					default:
+						end++;
+				}
+				return bstring_view(first, end + closers - first);
+			}
+
+			iterator begin() const {
+				return is_list() || is_dict() ? iterator(source, tokens, index + 1)
+					: end();
+			}
+			iterator end() const {
+				return iterator(source, tokens, tokens ? token().next : index);
+			}
+
+			// list element at position i; walks the preceding siblings
+			bview operator[](size_t i) const {
+				if (!is_list() || i >= size()) {
+					return bview();
+				}
+				iterator it = begin();
+				for (; i; i--) {
+					++it;
+				}
+				return *it;
+			}
+
+			// value stored under key, or an empty view if there is none
+			bview find(const unsigned char* key, size_t key_len) const {
+				if (!is_dict()) {
+					return bview();
+				}
+				for (iterator it = begin(), last = end(); it != last; ++it) {
+					bstring_view k = (*it).string();
+					++it;
+					if (k.size() == key_len && std::memcmp(k.data(), key, key_len) == 0) {
+						return *it;
+					}
+				}
+				return bview();
+			}
+			bview find(char const* key) const {
+				return find(reinterpret_cast<const unsigned char*>(key), strlen(key));
+			}
+
+		private:
+			const btoken& token() const {
+				assert(tokens);
+				return tokens[index];
+			}
+	};
+
+	// decodes a bencoded value in place; nothing is copied out of the source
+	// buffer and nothing is allocated, the structure is recorded in a caller
+	// supplied array of btokens instead
+	class bdecoder {
+		private:
+			btoken* tokens;
+			size_t capacity;
+			size_t count;
+			const unsigned char* source;
+		public:
+			bdecoder(btoken* tokens, size_t capacity) : tokens(tokens),
+				capacity(capacity < detail::no_token ? capacity : detail::no_token),
+				count(0), source(NULL) {};
+			template<size_t Size> bdecoder(std::array<btoken, Size>& tokens) :
+				bdecoder(tokens.data(), tokens.size()) {};
+
+			// decodes the single value at the start of data; returns a pointer just
+			// past it, or NULL if the input is malformed, truncated or needs more
+			// tokens than are available
+			const unsigned char* operator()(const unsigned char* data, size_t len) {
+				return decode<false>(data, len);
+			}
+
+			// like operator(), but also rejects input that is not in canonical
+			// form: dict keys out of order or repeated, integers with leading
+			// zeros, and i-0e; validation happens in the same pass and touches no
+			// string payload other than dict keys
+			const unsigned char* canonical(const unsigned char* data, size_t len) {
+				return decode<true>(data, len);
+			}
+
+			// the outermost decoded value
+			bview root() const {
+				assert(count);
+				return bview(source, tokens, 0);
+			}
+
+			// number of tokens used by the last decode
+			size_t size() const { return count; }
+
+		private:
+			template<bool Canonical> const unsigned char* decode(
+					const unsigned char* data, size_t len) {
+				assert(tokens);
+				count = 0;
+				source = data;
+				if (len >= detail::no_token) {
+					return NULL;
+				}
+				const unsigned char* p = data;
+				const unsigned char* const end = data + len;
+				// innermost open container; while open, a container's 'next' links
+				// to its parent, and its 'length' counts its child tokens
+				std::uint32_t open = detail::no_token;
+				// previous key of the innermost open container, if it is a dict; a
+				// container's key is always the token right before it, so this is
+				// recovered on closing a dict's value instead of being stacked
+				std::uint32_t last_key = detail::no_token;
+				do {
+					if (p == end) {
+						return NULL;
+					}
+					if (*p == 'e') {
+						if (open == detail::no_token) {
+							return NULL;
+						}
+						btoken& container = tokens[open];
+						if (container.type == btype::dict) {
+							if (container.length % 2) {
+								return NULL;
+							}
+							container.length /= 2;
+						}
+						last_key = open - 1;
+						open = container.next;
+						container.next = std::uint32_t(count);
+						p++;
+						continue;
+					}
+					if (count == capacity) {
+						return NULL;
+					}
+					if (open != detail::no_token) {
+						btoken& parent = tokens[open];
+						if (parent.type == btype::dict && parent.length % 2 == 0
+								&& (*p < '0' || *p > '9')) {
+							// dict keys must be strings
+							return NULL;
+						}
+						parent.length++;
+					}
+					btoken& t = tokens[count];
+					std::uint32_t self = std::uint32_t(count++);
+					switch (*p) {
+						case 'i': {
+							std::int64_t value;
+							const unsigned char* e = detail::parse_integer(p + 1, end, value);
+							if (!e) {
+								return NULL;
+							}
+							if (Canonical && (p[1] == '-' ? p[2] == '0' : p[1] == '0' && e - p > 2)) {
+								// leading zero or negative zero
+								return NULL;
+							}
+							t.type = btype::integer;
+							t.offset = std::uint32_t(p + 1 - data);
+							t.length = std::uint32_t(e - p - 1);
+							t.next = self + 1;
+							p = e + 1;
+							break;
+						}
+						case 'l':
+						case 'd':
+							t.type = *p == 'l' ? btype::list : btype::dict;
+							t.offset = std::uint32_t(p - data);
+							t.length = 0;
+							t.next = open;
+							open = self;
+							p++;
+							last_key = detail::no_token;
+							break;
+						default: {
+							size_t n;
+							p = detail::parse_length(p, end, n);
+							if (!p) {
+								return NULL;
+							}
+							t.type = btype::string;
+							t.offset = std::uint32_t(p - data);
+							t.length = std::uint32_t(n);
+							t.next = self + 1;
+							if (Canonical && open != detail::no_token
+									&& tokens[open].type == btype::dict && tokens[open].length % 2) {
+								if (last_key != detail::no_token
+										&& !detail::key_precedes(data, tokens[last_key], t)) {
+									return NULL;
+								}
+								last_key = self;
+							}
+							p += n;
+						}
+					}
+				} while (open != detail::no_token);
+				return p;
+			}
+	};
+
+	template<typename Arena> bool bvalue::load(Arena& arena, bview source,
+			size_t max_depth) {
+		switch (source.type()) {
+			case btype::integer:
+				*this = bvalue(source.integer());
+				return true;
+			case btype::string:
+				*this = bvalue(source.string());
+				return true;
+			default: {
+				*this = bvalue(source.type());
+				if (!max_depth || !reserve(arena, source.size())) {
+					return false;
+				}
+				bvalue* item = items;
+				for (bview::iterator it = source.begin(), last = source.end();
+						it != last; ++it, ++item) {
+					if (!item->load(arena, *it, max_depth - 1)) {
+						return false;
+					}
+				}
+				count = source.size();
+				return true;
+			}
+		}
+	}
+
+	namespace detail {
+		template<typename T, typename I = typename integer_of<T>::type>
+			bool integer_fits(std::int64_t value) {
+			return std::is_signed<I>::value
+				? value >= std::int64_t(std::numeric_limits<I>::min())
+					&& value <= std::int64_t(std::numeric_limits<I>::max())
+				: value >= 0
+					&& std::uint64_t(value) <= std::uint64_t(std::numeric_limits<I>::max());
+		}
+	}
+
+	// decodes source into out, which may be an integer, an std::string or
+	// vector of chars, a bstring_view referring to the decoded buffer, an
+	// std::array<unsigned char, N> of exactly N bytes, an std::vector or
+	// std::optional of any of these, or a struct declared with EBB_FIELDS;
+	// returns false if source has another type or does not fit
+	template<typename T> typename std::enable_if<
+		detail::is_bencodable_integer<T>::value, bool>::type bdecode(bview source,
+				T& out) {
+		if (!source.is_integer() || !detail::integer_fits<T>(source.integer())) {
+			return false;
+		}
+		out = T(source.integer());
+		return true;
+	}
+
+	inline bool bdecode(bview source, bstring_view& out) {
+		if (!source.is_string()) {
+			return false;
+		}
+		out = source.string();
+		return true;
+	}
+
+	inline bool bdecode(bview source, std::string& out) {
+		if (!source.is_string()) {
+			return false;
+		}
+		out.assign(reinterpret_cast<const char*>(source.string().data()),
+				source.string().size());
+		return true;
+	}
+
+	inline bool bdecode(bview source, std::vector<unsigned char>& out) {
+		if (!source.is_string()) {
+			return false;
+		}
+		out.assign(source.string().begin(), source.string().end());
+		return true;
+	}
+
+	inline bool bdecode(bview source, std::vector<char>& out) {
+		if (!source.is_string()) {
+			return false;
+		}
+		out.assign(source.string().begin(), source.string().end());
+		return true;
+	}
+
+	template<size_t N> bool bdecode(bview source, std::array<unsigned char, N>& out) {
+		if (!source.is_string() || source.string().size() != N) {
+			return false;
+		}
+		std::memcpy(out.data(), source.string().data(), N);
+		return true;
+	}
+
+	template<typename T, typename A> bool bdecode(bview source,
+			std::vector<T, A>& out) {
+		if (!source.is_list()) {
+			return false;
+		}
+		out.clear();
+		out.reserve(source.size());
+		for (bview::iterator it = source.begin(), last = source.end(); it != last;
+				++it) {
+			out.emplace_back();
+			if (!bdecode(*it, out.back())) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+#if __cplusplus >= 201703L
+	template<typename T> bool bdecode(bview source, std::optional<T>& out) {
+		out.emplace();
+		return bdecode(source, *out);
+	}
+#endif
+
+	namespace detail {
+		template<int I, typename T, typename Schema> bool decode_field(bview source,
+				T& out, Schema const& schema) {
+			return bdecode(source, out.*std::get<I>(schema).member);
+		}
+
+		// matches each key by length, then by memcmp, against the struct's keys
+		// in canonical order, starting after the previous match, so a canonical
+		// dict takes a single comparison per known key; unknown keys are skipped
+		template<typename T, typename Schema, int... P> bool decode_fields(
+				bview source, T& out, Schema const& schema, seq<P...>) {
+			typedef bool (*decoder)(bview, T&, Schema const&);
+			static const decoder decoders[] = {&decode_field<P, T, Schema>...};
+			static const size_t lengths[] = {
+				sizeof(std::tuple_element<P, Schema>::type::key::data) - 1 ...};
+			static const unsigned char* const names[] = {
+				std::tuple_element<P, Schema>::type::key::data...};
+			const size_t n = sizeof...(P);
+			size_t next = 0;
+			for (bview::iterator it = source.begin(), last = source.end(); it != last;
+					++it) {
+				bstring_view key = (*it).string();
+				++it;
+				for (size_t tried = 0; tried < n; tried++) {
+					size_t i = next;
+					next = next + 1 == n ? 0 : next + 1;
+					if (lengths[i] == key.size()
+							&& std::memcmp(names[i], key.data(), key.size()) == 0) {
+						if (!decoders[i](*it, out, schema)) {
+							return false;
+						}
+						break;
+					}
+				}
+			}
+			return true;
+		}
+	}
+
+	// members whose keys are missing from source are left as they are
+	template<typename T> typename std::enable_if<detail::has_fields<T>::value,
+		bool>::type bdecode(bview source, T& out) {
+		typedef typename detail::fields_of<T>::schema schema;
+		return source.is_dict() && detail::decode_fields(source, out,
+				ebb_fields(static_cast<T const*>(NULL)),
+				typename detail::schema_order<schema>::type());
+	}
+
+	// resumable SAX-style parser for bencoded data arriving in fragments of any
+	// size, e.g. off a TCP stream; it keeps a fixed-size state of at most
+	// MaxDepth nested containers and never buffers, reporting to a Visitor:
+	//   begin_dict(), begin_list(), end()
+	//   integer(std::int64_t value)
+	//   key(const unsigned char* data, size_t size, size_t remaining)
+	//   string(const unsigned char* data, size_t size, size_t remaining)
+	// Keys and strings are delivered piecewise as their bytes arrive, with
+	// remaining being how many bytes of them are still to come; the last piece
+	// has remaining == 0, an empty string is a single empty piece.
+	template<typename Visitor, size_t MaxDepth = 32> class bparser {
+		private:
+			enum state_type { value, integer, length, payload, complete, failure };
+			enum frame_type { list, dict_key, dict_value };
+
+			Visitor& visitor;
+			state_type state;
+			std::array<unsigned char, MaxDepth> frames;
+			size_t depth;
+			// integer or length being parsed, or payload bytes still to come
+			std::uint64_t number;
+			size_t digits;
+			bool negative;
+			bool is_key;
+		public:
+			explicit bparser(Visitor& visitor) : visitor(visitor) {
+				reset();
+			}
+
+			// consumes as much of data as belongs to the current value and returns
+			// how many bytes that was; stops after the end of a complete value, so
+			// anything following it, e.g. the payload of a BEP 9 data message, is
+			// left to the caller
+			size_t feed(const unsigned char* data, size_t size) {
+				const unsigned char* p = data;
+				const unsigned char* const end = data + size;
+				while (p != end && state != complete && state != failure) {
+					switch (state) {
+						case value:
+							p = parse_value(p);
+							break;
+						case integer:
+							p = parse_integer(p, end);
+							break;
+						case length:
+							p = parse_length(p, end);
+							break;
+						default:
+							p = parse_payload(p, end);
+					}
+				}
+				return p - data;
+			}
+
+			// a complete value has been parsed
+			bool done() const { return state == complete; }
+			// the input was malformed or nested deeper than MaxDepth
+			bool failed() const { return state == failure; }
+
+			// prepares for the next value
+			void reset() {
+				state = value;
+				depth = 0;
+				number = 0;
+				digits = 0;
+				negative = false;
+				is_key = false;
+			}
+
+		private:
+			const unsigned char* parse_value(const unsigned char* p) {
+				unsigned char c = *p;
+				if (depth && frames[depth - 1] == dict_key && c != 'e'
+						&& (c < '0' || c > '9')) {
+					// dict keys must be strings
+					state = failure;
+					return p;
+				}
+				switch (c) {
+					case 'e':
+						if (!depth || frames[depth - 1] == dict_value) {
+							state = failure;
+							return p;
+						}
+						depth--;
+						visitor.end();
+						value_done();
+						break;
+					case 'i':
+						state = integer;
+						number = 0;
+						digits = 0;
+						negative = false;
+						break;
+					case 'l':
+					case 'd':
+						if (depth == MaxDepth) {
+							state = failure;
+							return p;
+						}
+						frames[depth++] = c == 'l' ? list : dict_key;
+						if (c == 'l') {
+							visitor.begin_list();
+						} else {
+							visitor.begin_dict();
+						}
+						break;
+					default:
+						if (c < '0' || c > '9') {
+							state = failure;
+							return p;
+						}
+						state = length;
+						number = c - '0';
+						is_key = depth && frames[depth - 1] == dict_key;
+				}
+				return p + 1;
+			}
+
+			const unsigned char* parse_integer(const unsigned char* p,
+					const unsigned char* end) {
+				for (; p != end; p++) {
+					unsigned char c = *p;
+					if (c >= '0' && c <= '9') {
+						const std::uint64_t limit = negative
+							? std::uint64_t(INT64_MAX) + 1 : std::uint64_t(INT64_MAX);
+						unsigned digit = c - '0';
+						if (number > (limit - digit) / 10) {
+							state = failure;
+							return p;
+						}
+						number = number * 10 + digit;
+						digits++;
+					} else if (c == '-' && !digits && !negative) {
+						negative = true;
+					} else if (c == 'e' && digits) {
+						visitor.integer(negative ? std::int64_t(0 - number)
+								: std::int64_t(number));
+						value_done();
+						return p + 1;
+					} else {
+						state = failure;
+						return p;
+					}
+				}
+				return p;
+			}
+
+			const unsigned char* parse_length(const unsigned char* p,
+					const unsigned char* end) {
+				for (; p != end; p++) {
+					unsigned char c = *p;
+					if (c >= '0' && c <= '9' && number != 0) {
+						if (number > (SIZE_MAX - (c - '0')) / 10) {
+							state = failure;
+							return p;
+						}
+						number = number * 10 + (c - '0');
+					} else if (c == ':') {
+						if (number) {
+							state = payload;
+							return p + 1;
+						}
+						emit(p, 0);
+						value_done();
+						return p + 1;
+					} else {
+						// not a digit, or a leading zero
+						state = failure;
+						return p;
+					}
+				}
+				return p;
+			}
+
+			const unsigned char* parse_payload(const unsigned char* p,
+					const unsigned char* end) {
+				size_t n = size_t(end - p) < number ? size_t(end - p) : size_t(number);
+				number -= n;
+				emit(p, n);
+				if (!number) {
+					value_done();
+				}
+				return p + n;
+			}
+
+			void emit(const unsigned char* data, size_t size) {
+				if (is_key) {
+					visitor.key(data, size, size_t(number));
+				} else {
+					visitor.string(data, size, size_t(number));
+				}
+			}
+
+			void value_done() {
+				if (!depth) {
+					state = complete;
+					return;
+				}
+				state = value;
+				unsigned char& frame = frames[depth - 1];
+				if (frame != list) {
+					frame = frame == dict_key ? dict_value : dict_key;
+				}
+			}
+	};
+
+	namespace detail {
+		// returns a pointer just past the value at p, found by following length
+		// prefixes and counting nesting rather than recording any structure, or
+		// NULL if it is malformed or runs past end
+		inline const unsigned char* skip_value(const unsigned char* p,
+				const unsigned char* end) {
+			size_t depth = 0;
+			do {
+				if (p == end) {
+					return NULL;
+				}
+				switch (*p) {
+					case 'e':
+						if (!depth) {
+							return NULL;
+						}
+						depth--;
+						p++;
+						break;
+					case 'i': {
+						std::int64_t value;
+						p = parse_integer(p + 1, end, value);
+						if (!p) {
+							return NULL;
+						}
+						p++;
+						break;
+					}
+					case 'l':
+					case 'd':
+						depth++;
+						p++;
+						break;
+					default: {
+						size_t n;
+						p = parse_length(p, end, n);
+						if (!p) {
+							return NULL;
+						}
+						p += n;
+					}
+				}
+			} while (depth);
+			return p;
+		}
+	}
+
+	// view of a bencoded value that is only ever parsed as far as it is
+	// accessed: lookups skip over the values before the one wanted instead of
+	// decoding them, so reaching one field of a large document touches little
+	// more than the bytes on the way to it. Relies on dicts being in canonical
+	// order, as bencoder writes them, to stop looking for a key early. Malformed
+	// input yields empty views
+	class blazy {
+		private:
+			const unsigned char* first;
+			const unsigned char* last;
+		public:
+			// iterates over the elements of a list, or the alternating keys and
+			// values of a dict, skipping each one to find the next
+			class iterator {
+				private:
+					const unsigned char* p;
+					const unsigned char* last;
+				public:
+					iterator(const unsigned char* p, const unsigned char* last) : p(p),
+						last(last) {
+						settle();
+					};
+					blazy operator*() const { return blazy(p, last - p); }
+					iterator& operator++() {
+						p = detail::skip_value(p, last);
+						settle();
+						return *this;
+					}
+					bool operator==(iterator const& other) const { return p == other.p; }
+					bool operator!=(iterator const& other) const { return p != other.p; }
+				private:
+					// the end of the container is represented as NULL
+					void settle() {
+						if (p && (p == last || *p == 'e')) {
+							p = NULL;
+						}
+					}
+			};
+
+			blazy() : first(NULL), last(NULL) {};
+			// the value at the start of data, with len the bytes it may extend over
+			blazy(const unsigned char* data, size_t len) : first(len ? data : NULL),
+				last(len ? data + len : NULL) {};
+
+			// false for the value returned by a failed lookup; as with bview, every
+			// accessor is safe on such an empty view and on a view of the wrong
+			// type, so that lookups can be chained and checked once at the end
+			explicit operator bool() const { return first != NULL; }
+			// an empty view has no type and reports btype::integer
+			btype type() const {
+				if (!first) {
+					return btype::integer;
+				}
+				switch (*first) {
+					case 'i':
+						return btype::integer;
+					case 'l':
+						return btype::list;
+					case 'd':
+						return btype::dict;
+					default:
+						return btype::string;
+				}
+			}
+			bool is_integer() const { return first && *first == 'i'; }
+			bool is_string() const { return first && *first >= '0' && *first <= '9'; }
+			bool is_list() const { return first && *first == 'l'; }
+			bool is_dict() const { return first && *first == 'd'; }
+
+			// 0 if this is not a well-formed integer
+			std::int64_t integer() const {
+				std::int64_t value = 0;
+				if (!is_integer()) {
+					return value;
+				}
+				detail::parse_integer(first + 1, last, value);
+				return value;
+			}
+
+			// empty if this is not a well-formed string
+			bstring_view string() const {
+				if (!is_string()) {
+					return bstring_view();
+				}
+				size_t n;
+				const unsigned char* p = detail::parse_length(first, last, n);
+				return p ? bstring_view(p, n) : bstring_view();
+			}
+
+			// the raw bencoded bytes of this value, e.g. for hashing an info dict
+			bstring_view raw() const {
+				const unsigned char* end = first ? detail::skip_value(first, last) : NULL;
+				return end ? bstring_view(first, end - first) : bstring_view();
+			}
+
+			iterator begin() const {
+				return is_list() || is_dict() ? iterator(first + 1, last) : end();
+			}
+			iterator end() const {
+				return iterator(NULL, last);
+			}
+
+			// number of list elements or dict entries; walks all of them
+			size_t size() const {
+				size_t n = 0;
+				for (iterator it = begin(), e = end(); it != e; ++it) {
+					n++;
+				}
+				return is_dict() ? n / 2 : n;
+			}
+
+			// list element at position i, or an empty view if there is none
+			blazy operator[](size_t i) const {
+				if (!is_list()) {
+					return blazy();
+				}
+				iterator it = begin(), e = end();
+				for (; it != e && i; ++it, i--) {
+				}
+				return it != e ? *it : blazy();
+			}
+
+			// value stored under key, or an empty view if there is none
+			blazy find(bstring_view key) const {
+				if (!is_dict()) {
+					return blazy();
+				}
+				for (iterator it = begin(), e = end(); it != e; ++it) {
+					blazy k = *it;
+					if (!k.is_string()) {
+						return blazy();
+					}
+					++it;
+					if (it == e) {
+						return blazy();
+					}
+					bstring_view name = k.string();
+					if (name == key) {
+						return *it;
+					}
+					if (detail::key_less(key, name)) {
+						// keys are sorted, so key is not in here
+						return blazy();
+					}
+				}
+				return blazy();
+			}
+			blazy find(char const* key) const {
+				return find(bstring_view(reinterpret_cast<const unsigned char*>(key),
+							strlen(key)));
+			}
+	};
+
+	// lazy reader for .torrent files: nothing is parsed up front, the info
+	// dict, piece hashes and file list are located the first time they are
+	// asked for, and piece hashes and names come back as views into the file.
+	// open() maps the file read-only instead of reading it in
+	class btorrent {
+		private:
+			const unsigned char* source;
+			size_t len;
+			bool mapped;
+			blazy info_dict;
+			// keys and values of the info dict, found in one pass on first access
+			// so that later lookups skip nothing; dicts with more entries than fit
+			// are searched in place beyond these
+			std::array<std::pair<bstring_view, blazy>, 16> info_entries;
+			size_t info_count;
+			// entries of info.files, found on first access
+			std::vector<blazy> files;
+			bool files_indexed;
+		public:
+			btorrent() : source(NULL), len(0), mapped(false), info_count(0),
+				files_indexed(false) {};
+			// reads a .torrent that is already in memory, which has to outlive this
+			btorrent(const unsigned char* data, size_t len) : btorrent() {
+				source = data;
+				this->len = len;
+			}
+			btorrent(btorrent const&) = delete;
+			btorrent& operator=(btorrent const&) = delete;
+			~btorrent() {
+				close();
+			}
+
+#ifndef _WIN32
+			// maps the file at path; returns false, with errno set, if it cannot
+			bool open(const char* path) {
+				close();
+				int fd = ::open(path, O_RDONLY);
+				if (fd < 0) {
+					return false;
+				}
+				struct stat status;
+				int failed = fstat(fd, &status);
+				if (failed || status.st_size == 0) {
+					int error = failed ? errno : EINVAL;
+					::close(fd);
+					errno = error;
+					return false;
+				}
+				void* map = mmap(NULL, size_t(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+				int error = errno;
+				::close(fd);
+				if (map == MAP_FAILED) {
+					errno = error;
+					return false;
+				}
+				source = static_cast<const unsigned char*>(map);
+				len = size_t(status.st_size);
+				mapped = true;
+				return true;
+			}
+#endif
+
+			void close() {
+#ifndef _WIN32
+				if (mapped) {
+					munmap(const_cast<unsigned char*>(source), len);
+				}
+#endif
+				source = NULL;
+				len = 0;
+				mapped = false;
+				info_dict = blazy();
+				info_count = 0;
+				files.clear();
+				files_indexed = false;
+			}
+
+			blazy root() const {
+				return blazy(source, len);
+			}
+
+			// empty if the torrent has no info dict
+			blazy info() {
+				if (!info_dict) {
+					blazy r = root();
+					blazy found = r.is_dict() ? r.find("info") : blazy();
+					if (!found.is_dict()) {
+						return blazy();
+					}
+					info_dict = found;
+					for (blazy::iterator it = found.begin(), e = found.end();
+							it != e && info_count < info_entries.size(); ++it) {
+						blazy key = *it;
+						if (!key.is_string() || ++it == e) {
+							break;
+						}
+						info_entries[info_count++] = std::make_pair(key.string(), *it);
+					}
+				}
+				return info_dict;
+			}
+
+			// value stored under key in the info dict, or an empty view
+			blazy info(bstring_view key) {
+				if (!info()) {
+					return blazy();
+				}
+				for (size_t i = 0; i < info_count; i++) {
+					if (info_entries[i].first == key) {
+						return info_entries[i].second;
+					}
+				}
+				return info_count == info_entries.size() ? info_dict.find(key) : blazy();
+			}
+			blazy info(char const* key) {
+				return info(bstring_view(reinterpret_cast<const unsigned char*>(key),
+							strlen(key)));
+			}
+
+			bstring_view name() {
+				blazy n = info("name");
+				return n.is_string() ? n.string() : bstring_view();
+			}
+
+			// SHA-1 of the info dict as it appears in the file; false, leaving
+			// hash untouched, if there is no info dict
+			bool info_hash(std::array<unsigned char, 20>& hash) {
+				if (!info()) {
+					return false;
+				}
+				sha1 hasher;
+				bstring_view raw = info().raw();
+				hasher.update(raw.data(), raw.size());
+				hash = hasher.final();
+				return true;
+			}
+
+			size_t piece_count() {
+				return pieces().size() / 20;
+			}
+
+			// the 20-byte SHA-1 of piece i, or an empty view if there is none
+			bstring_view piece(size_t i) {
+				bstring_view all = pieces();
+				if (i >= all.size() / 20) {
+					return bstring_view();
+				}
+				return bstring_view(all.data() + 20 * i, 20);
+			}
+
+			// number of entries in info.files; 0 for a single-file torrent
+			size_t file_count() {
+				index_files();
+				return files.size();
+			}
+
+			// entry i of info.files, a dict with "length" and "path"
+			blazy file(size_t i) {
+				index_files();
+				if (i >= files.size()) {
+					return blazy();
+				}
+				return files[i];
+			}
+
+		private:
+			bstring_view pieces() {
+				blazy p = info("pieces");
+				return p.is_string() ? p.string() : bstring_view();
+			}
+
+			void index_files() {
+				if (files_indexed) {
+					return;
+				}
+				files_indexed = true;
+				blazy list = info("files");
+				if (!list.is_list()) {
+					return;
+				}
+				for (blazy::iterator it = list.begin(), e = list.end(); it != e; ++it) {
+					files.push_back(*it);
+				}
 			}
 	};
 }
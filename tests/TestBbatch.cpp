@@ -0,0 +1,177 @@
+// Copyright (C) 2014 Igor Kaplounenko
+// Licensed under MIT License
+
+#include "ebb.hpp"
+
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+using namespace ebb;
+
+// produces message i of a batch of KRPC responses
+struct responses {
+	template<typename Encode> bool operator()(size_t i, Encode& encode) const {
+		return encode(bdict(
+					k_v("r", bdict(k_v("id", "abcdefghij0123456789"),
+							k_v("n", static_cast<std::int64_t>(i * i)))),
+					k_v("t", static_cast<std::int64_t>(i)),
+					k_v("y", "r")));
+	}
+};
+
+static std::string expected(size_t i) {
+	unsigned char output[128];
+	unsigned char* last = bencoder(output, sizeof(output))(bdict(
+				k_v("r", bdict(k_v("id", "abcdefghij0123456789"),
+						k_v("n", static_cast<std::int64_t>(i * i)))),
+				k_v("t", static_cast<std::int64_t>(i)),
+				k_v("y", "r")));
+	return std::string(reinterpret_cast<const char*>(output), last - output);
+}
+
+TEST(bbatch, append) {
+	std::array<unsigned char, 256> buffer;
+	std::array<bslice, 4> slices;
+	bbatch batch(buffer.data(), buffer.size(), slices.data(), slices.size());
+	ASSERT_TRUE(batch(bdict(k_v("y", "q"))));
+	ASSERT_TRUE(batch(blist(1, 2)));
+	EXPECT_EQ(2u, batch.size());
+	EXPECT_EQ(16u, batch.bytes());
+	EXPECT_TRUE(batch[0] == "d1:y1:qe");
+	EXPECT_TRUE(batch[1] == "li1ei2ee");
+	EXPECT_EQ(8u, batch.slices()[1].offset);
+	EXPECT_EQ(buffer.data() + 8, batch[1].data());
+	ASSERT_TRUE(batch.append(2, responses()));
+	EXPECT_EQ(4u, batch.size());
+	EXPECT_EQ(expected(1), batch[3].str());
+	// the table is full
+	EXPECT_FALSE(batch(1));
+	batch.clear();
+	EXPECT_EQ(0u, batch.size());
+	EXPECT_EQ(0u, batch.bytes());
+}
+
+TEST(bbatch, buffer_full) {
+	std::array<unsigned char, 12> buffer;
+	std::array<bslice, 4> slices;
+	bbatch batch(buffer.data(), buffer.size(), slices.data(), slices.size());
+	ASSERT_TRUE(batch("hello"));
+	EXPECT_FALSE(batch("world!"));
+	EXPECT_EQ(1u, batch.size());
+	EXPECT_EQ(7u, batch.bytes());
+	ASSERT_TRUE(batch("abc"));
+	EXPECT_EQ(12u, batch.bytes());
+}
+
+TEST(bbatch, parallel) {
+	const size_t n = 1000;
+	std::vector<unsigned char> buffer(n * 128);
+	std::vector<bslice> slices(n + 1);
+	bbatch batch(buffer.data(), buffer.size(), slices.data(), slices.size());
+	ASSERT_TRUE(batch("first"));
+	ASSERT_TRUE(batch.append_parallel(n, responses(), 4));
+	ASSERT_EQ(n + 1, batch.size());
+	EXPECT_TRUE(batch[0] == "5:first");
+	size_t offset = 7;
+	for (size_t i = 0; i < n; i++) {
+		EXPECT_EQ(offset, batch.slices()[i + 1].offset);
+		EXPECT_EQ(expected(i), batch[i + 1].str()) << i;
+		offset += batch.slices()[i + 1].length;
+	}
+	EXPECT_EQ(offset, batch.bytes());
+}
+
+TEST(bbatch, parallel_does_not_fit) {
+	const size_t n = 100;
+	std::vector<unsigned char> buffer(1000);
+	std::vector<bslice> slices(n);
+	bbatch batch(buffer.data(), buffer.size(), slices.data(), slices.size());
+	EXPECT_FALSE(batch.append_parallel(n, responses(), 3));
+	EXPECT_EQ(0u, batch.size());
+	size_t total = 0;
+	for (size_t i = 0; i < n; i++) {
+		total += expected(i).size();
+	}
+	EXPECT_EQ(total, batch.needed());
+	// more workers than messages, or none, still work
+	EXPECT_TRUE(batch.append_parallel(2, responses(), 16));
+	EXPECT_TRUE(batch.append_parallel(2, responses(), 0));
+	EXPECT_EQ(4u, batch.size());
+	EXPECT_EQ(expected(1), batch[3].str());
+}
+
+// runs every task on the calling thread, in reverse, standing in for a pool
+struct inline_executor {
+	template<typename Task> void operator()(size_t workers, Task const& task) const {
+		for (size_t worker = workers; worker; worker--) {
+			task(worker - 1);
+		}
+	}
+};
+
+TEST(bbatch, custom_executor) {
+	const size_t n = 3 * bbatch::parallel_grain;
+	std::vector<unsigned char> buffer(n * 128);
+	std::vector<bslice> slices(n);
+	bbatch batch(buffer.data(), buffer.size(), slices.data(), slices.size());
+	ASSERT_TRUE(batch.append_parallel(n, responses(), 3, inline_executor()));
+	for (size_t i = 0; i < n; i++) {
+		EXPECT_EQ(expected(i), batch[i].str());
+	}
+	std::vector<struct iovec> iov(n);
+	batch.fill(iov.data());
+	EXPECT_EQ(batch[9].data(), iov[9].iov_base);
+	EXPECT_EQ(batch[9].size(), iov[9].iov_len);
+}
+
+// records how many workers it was asked for, running them inline
+struct counting_executor {
+	std::vector<size_t>* calls;
+	template<typename Task> void operator()(size_t workers, Task const& task) const {
+		calls->push_back(workers);
+		for (size_t worker = 0; worker < workers; worker++) {
+			task(worker);
+		}
+	}
+};
+
+TEST(bbatch, small_batches_stay_on_calling_thread) {
+	const size_t n = 2 * bbatch::parallel_grain + 1;
+	std::vector<unsigned char> buffer(n * 128);
+	std::vector<bslice> slices(n + 10);
+	bbatch batch(buffer.data(), buffer.size(), slices.data(), slices.size());
+	std::vector<size_t> calls;
+	counting_executor run = {&calls};
+	// too few messages to be worth a second worker
+	ASSERT_TRUE(batch.append_parallel(10, responses(), 4, run));
+	ASSERT_TRUE(batch.append_parallel(bbatch::parallel_grain * 2 - 1, responses(), 4,
+				run));
+	EXPECT_TRUE(calls.empty());
+	// workers are capped so that each gets at least parallel_grain messages
+	batch.clear();
+	ASSERT_TRUE(batch.append_parallel(n, responses(), 4, run));
+	ASSERT_EQ(2u, calls.size());
+	EXPECT_EQ(2u, calls[0]);
+	EXPECT_EQ(2u, calls[1]);
+	for (size_t i = 0; i < n; i++) {
+		EXPECT_EQ(expected(i), batch[i].str());
+	}
+}
+
+TEST(bbatch, threads_joined_when_a_task_throws) {
+	std::atomic<size_t> finished(0);
+	struct task {
+		std::atomic<size_t>* finished;
+		void operator()(size_t worker) const {
+			if (worker == 0) {
+				throw std::runtime_error("worker 0");
+			}
+			(*finished)++;
+		}
+	} throwing = {&finished};
+	// the other workers are joined, not left joinable, before the exception
+	// leaves bthreads
+	EXPECT_THROW(bthreads()(4, throwing), std::runtime_error);
+	EXPECT_EQ(3u, finished.load());
+}
@@ -0,0 +1,195 @@
+// Copyright (C) 2014 Igor Kaplounenko
+// Licensed under MIT License
+
+#include "ebb.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace ebb;
+
+static const unsigned char* bytes(const char* s) {
+	return reinterpret_cast<const unsigned char*>(s);
+}
+
+TEST(bdecoder, integer) {
+	std::array<btoken, 4> tokens;
+	const char* input = "i-3000e";
+	bdecoder decode(tokens);
+	const unsigned char* last = decode(bytes(input), strlen(input));
+	ASSERT_EQ(bytes(input) + strlen(input), last);
+	ASSERT_TRUE(decode.root().is_integer());
+	EXPECT_EQ(-3000, decode.root().integer());
+}
+
+TEST(bdecoder, integer_limits) {
+	std::array<btoken, 4> tokens;
+	bdecoder decode(tokens);
+	const char* max = "i9223372036854775807e";
+	ASSERT_NE(static_cast<const unsigned char*>(NULL), decode(bytes(max), strlen(max)));
+	EXPECT_EQ(INT64_MAX, decode.root().integer());
+	const char* min = "i-9223372036854775808e";
+	ASSERT_NE(static_cast<const unsigned char*>(NULL), decode(bytes(min), strlen(min)));
+	EXPECT_EQ(INT64_MIN, decode.root().integer());
+	const char* overflow = "i9223372036854775808e";
+	EXPECT_EQ(static_cast<const unsigned char*>(NULL),
+			decode(bytes(overflow), strlen(overflow)));
+}
+
+TEST(bdecoder, string) {
+	std::array<btoken, 4> tokens;
+	const char* input = "4:asdf";
+	bdecoder decode(tokens);
+	ASSERT_NE(static_cast<const unsigned char*>(NULL), decode(bytes(input), strlen(input)));
+	bstring_view s = decode.root().string();
+	// no copy is made, the view points into the input
+	EXPECT_EQ(bytes(input) + 2, s.data());
+	EXPECT_EQ(4u, s.size());
+	EXPECT_TRUE(s == "asdf");
+}
+
+TEST(bdecoder, list) {
+	std::array<btoken, 8> tokens;
+	const char* input = "l1:ai2el1:bee";
+	bdecoder decode(tokens);
+	ASSERT_NE(static_cast<const unsigned char*>(NULL), decode(bytes(input), strlen(input)));
+	EXPECT_EQ(5u, decode.size());
+	bview root = decode.root();
+	ASSERT_TRUE(root.is_list());
+	ASSERT_EQ(3u, root.size());
+	EXPECT_TRUE(root[0].string() == "a");
+	EXPECT_EQ(2, root[1].integer());
+	ASSERT_TRUE(root[2].is_list());
+	EXPECT_TRUE(root[2][0].string() == "b");
+	EXPECT_FALSE(root[3]);
+	size_t n = 0;
+	for (bview::iterator it = root.begin(); it != root.end(); ++it) {
+		n++;
+	}
+	EXPECT_EQ(3u, n);
+}
+
+TEST(bdecoder, dict) {
+	std::array<btoken, 16> tokens;
+	const char* input = "d1:ad2:id20:abcdefghij0123456789e1:q4:ping1:t2:aa1:y1:qe";
+	bdecoder decode(tokens);
+	ASSERT_NE(static_cast<const unsigned char*>(NULL), decode(bytes(input), strlen(input)));
+	bview root = decode.root();
+	ASSERT_TRUE(root.is_dict());
+	EXPECT_EQ(4u, root.size());
+	EXPECT_TRUE(root.find("q").string() == "ping");
+	EXPECT_TRUE(root.find("a").find("id").string() == "abcdefghij0123456789");
+	EXPECT_TRUE(root.find("y").string() == "q");
+	EXPECT_FALSE(root.find("r"));
+}
+
+TEST(bdecoder, missing_and_mistyped) {
+	std::array<btoken, 8> tokens;
+	const char* input = "d1:ai7e1:q4:ping1:ll1:xee";
+	bdecoder decode(tokens);
+	ASSERT_NE(static_cast<const unsigned char*>(NULL), decode(bytes(input), strlen(input)));
+	bview root = decode.root();
+
+	// missing keys chain into empty views
+	bview missing = root.find("r").find("port");
+	EXPECT_FALSE(missing);
+	EXPECT_FALSE(missing.is_integer() || missing.is_string() || missing.is_list()
+			|| missing.is_dict());
+	EXPECT_EQ(0, missing.integer());
+	EXPECT_TRUE(missing.string().empty());
+	EXPECT_TRUE(missing.raw().empty());
+	EXPECT_EQ(0u, missing.size());
+	EXPECT_TRUE(missing.begin() == missing.end());
+	EXPECT_FALSE(missing[0]);
+	EXPECT_FALSE(missing.find("port"));
+
+	// so do lookups into values of the wrong type
+	EXPECT_FALSE(root.find("q").find("port"));
+	EXPECT_FALSE(root.find("a")[0]);
+	EXPECT_FALSE(root.find("l").find("x"));
+	EXPECT_FALSE(root[0]);
+	EXPECT_EQ(0, root.find("q").integer());
+	EXPECT_TRUE(root.find("a").string().empty());
+	EXPECT_EQ(0u, root.find("a").size());
+	EXPECT_TRUE(root.find("a").begin() == root.find("a").end());
+	EXPECT_TRUE(root.find("l")[0].string() == "x");
+	EXPECT_FALSE(root.find("l")[1]);
+}
+
+TEST(bdecoder, raw) {
+	std::array<btoken, 16> tokens;
+	const char* input = "d4:infod6:lengthi5e4:name3:abc5:filesl0:leeee";
+	bdecoder decode(tokens);
+	ASSERT_NE(static_cast<const unsigned char*>(NULL), decode(bytes(input), strlen(input)));
+	bstring_view info = decode.root().find("info").raw();
+	EXPECT_TRUE(info == "d6:lengthi5e4:name3:abc5:filesl0:leee");
+	EXPECT_TRUE(decode.root().raw() == input);
+	EXPECT_TRUE(decode.root().find("info").find("name").raw() == "3:abc");
+	EXPECT_TRUE(decode.root().find("info").find("length").raw() == "i5e");
+}
+
+TEST(bdecoder, trailing_data) {
+	std::array<btoken, 4> tokens;
+	const char* input = "i1e4:asdf";
+	bdecoder decode(tokens);
+	EXPECT_EQ(bytes(input) + 3, decode(bytes(input), strlen(input)));
+}
+
+TEST(bdecoder, malformed) {
+	std::array<btoken, 16> tokens;
+	bdecoder decode(tokens);
+	const char* inputs[] = {"", "i12", "ie", "i-e", "i1-2e", "5:abc", "03:abc", "l",
+		"e", "x", "di1ei2ee", "d1:ae", "1:", "4294967296:a"};
+	for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+		const char* input = inputs[i];
+		EXPECT_EQ(static_cast<const unsigned char*>(NULL),
+				decode(bytes(input), strlen(input))) << input;
+	}
+}
+
+TEST(bdecoder, token_bounds) {
+	std::array<btoken, 3> tokens;
+	const char* input = "l1:a1:b1:ce";
+	bdecoder decode(tokens);
+	EXPECT_EQ(static_cast<const unsigned char*>(NULL), decode(bytes(input), strlen(input)));
+}
+
+TEST(bdecoder, reencode) {
+	std::array<btoken, 8> tokens;
+	const char* input = "d1:t2:xy1:y1:qe";
+	bdecoder decode(tokens);
+	ASSERT_NE(static_cast<const unsigned char*>(NULL), decode(bytes(input), strlen(input)));
+	unsigned char output[1024];
+	unsigned char* last = bencoder(output, 1024)(
+			bdict(
+				k_v("t", decode.root().find("t").string()),
+				k_v("y", "r")
+				)
+			);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	*last = '\0';
+	EXPECT_STREQ("d1:t2:xy1:y1:re", reinterpret_cast<const char*>(output));
+}
+
+TEST(bdecoder, canonical) {
+	std::array<btoken, 32> tokens;
+	bdecoder decode(tokens);
+	const char* valid[] = {"i0e", "i-1e", "i10e", "de", "d0:i1ee",
+		"d1:ai1e2:aai2e1:bi3ee", "d1:ad1:zi1ee1:bl1:zee",
+		"d1:ald1:bi1e1:ci2eee1:bi1ee", "l1:b1:ae"};
+	for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+		const char* input = valid[i];
+		EXPECT_EQ(bytes(input) + strlen(input), decode.canonical(bytes(input),
+					strlen(input))) << input;
+	}
+	const char* invalid[] = {"i-0e", "i00e", "i01e", "i-01e", "d1:bi1e1:ai2ee",
+		"d1:ai1e1:ai2ee", "d2:aai1e1:ai2ee", "d1:ad1:zi1e1:yi2eee",
+		"d1:ali1ee1:0i2ee", "d1:ad1:bi1ee1:ai2ee"};
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		const char* input = invalid[i];
+		EXPECT_EQ(static_cast<const unsigned char*>(NULL),
+				decode.canonical(bytes(input), strlen(input))) << input;
+		// non-canonical, but otherwise well-formed
+		EXPECT_NE(static_cast<const unsigned char*>(NULL),
+				decode(bytes(input), strlen(input))) << input;
+	}
+}
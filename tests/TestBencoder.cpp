@@ -39,6 +39,90 @@ TEST(ebb, integer_bounds) {
 	EXPECT_EQ(static_cast<unsigned char*>(NULL), last);
 }
 
+TEST(ebb, integer_exact_fit) {
+	unsigned char output[6];
+	unsigned char* last = bencoder(output, 6)(
+			-3000
+			);
+	EXPECT_EQ(static_cast<unsigned char*>(NULL), last);
+	last = bencoder(output, 6)(
+			3000
+			);
+	ASSERT_EQ(output + 6, last);
+	EXPECT_EQ(0, memcmp("i3000e", output, 6));
+}
+
+TEST(ebb, integer_types) {
+	unsigned char output[1024];
+	unsigned char* last = bencoder(output, 1024)(
+			blist(
+				0,
+				-1,
+				std::int8_t(-128),
+				std::uint8_t(255),
+				std::int16_t(-32768),
+				std::uint16_t(65535),
+				std::int32_t(INT32_MIN),
+				std::uint32_t(UINT32_MAX),
+				size_t(42),
+				INT64_MIN,
+				INT64_MAX,
+				UINT64_MAX
+				)
+			);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	*last = '\0';
+	EXPECT_STREQ("li0ei-1ei-128ei255ei-32768ei65535ei-2147483648ei4294967295ei42e"
+			"i-9223372036854775808ei9223372036854775807ei18446744073709551615ee",
+			reinterpret_cast<char*>(output));
+}
+
+enum message_type { query = 1, response = 2, error_reply = -3 };
+enum big_flags : std::uint64_t { top_bit = 0x8000000000000000ull };
+enum class scoped_type { a };
+
+TEST(ebb, integer_enums) {
+	static_assert(detail::is_bencodable_integer<message_type>::value,
+			"unscoped enums encode as their underlying integer");
+	static_assert(!detail::is_bencodable_integer<scoped_type>::value,
+			"scoped enums have to be cast explicitly");
+	unsigned char output[64];
+	unsigned char* last = bencoder(output, sizeof(output))(
+			blist(response, error_reply, top_bit));
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	EXPECT_EQ("li2ei-3ei9223372036854775808ee",
+			std::string(reinterpret_cast<char*>(output), last - output));
+	EXPECT_EQ(size_t(last - output),
+			bencoded_size(blist(response, error_reply, top_bit)));
+
+	std::array<btoken, 8> tokens;
+	bdecoder decode(tokens);
+	last = bencoder(output, sizeof(output))(blist(response, error_reply));
+	ASSERT_NE(static_cast<const unsigned char*>(NULL), decode(output, last - output));
+	message_type type = query;
+	EXPECT_TRUE(bdecode(decode.root()[1], type));
+	EXPECT_EQ(error_reply, type);
+	big_flags flags = big_flags();
+	EXPECT_FALSE(bdecode(decode.root()[1], flags));
+}
+
+TEST(ebb, integer_digits) {
+	unsigned char output[64];
+	char expected[64];
+	std::uint64_t value = 1;
+	for (int i = 0; i < 20; i++, value *= 10) {
+		std::uint64_t values[] = {value - 1, value, value + 1};
+		for (size_t j = 0; j < 3; j++) {
+			unsigned char* last = bencoder(output, 64)(values[j]);
+			ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+			*last = '\0';
+			snprintf(expected, sizeof(expected), "i%llue",
+					static_cast<unsigned long long>(values[j]));
+			EXPECT_STREQ(expected, reinterpret_cast<char*>(output));
+		}
+	}
+}
+
 TEST(ebb, string) {
 	unsigned char output[1024];
 	unsigned char* last = bencoder(output, 1024)(
@@ -57,6 +141,19 @@ TEST(ebb, string_bounds) {
 	EXPECT_EQ(static_cast<unsigned char*>(NULL), last);
 }
 
+TEST(ebb, string_exact_fit) {
+	unsigned char output[6];
+	unsigned char* last = bencoder(output, 6)(
+			"asdf"
+			);
+	ASSERT_EQ(output + 6, last);
+	EXPECT_EQ(0, memcmp("4:asdf", output, 6));
+	last = bencoder(output, 6)(
+			"0123456789"
+			);
+	EXPECT_EQ(static_cast<unsigned char*>(NULL), last);
+}
+
 TEST(ebb, array) {
 	unsigned char output[1024];
 	std::array<unsigned char, 3> data1 = {{'\1', '\0', '\2'}};
@@ -196,3 +293,350 @@ TEST(ebb, array_constructor) {
 	*last = '\0';
 	EXPECT_STREQ(expected, reinterpret_cast<const char*>(output.data()));
 }
+
+TEST(ebb, bencoded_size) {
+	unsigned char output[1024];
+	std::array<unsigned char, 3> data1 = {{'e', 'f', 'g'}};
+	std::vector<unsigned char> data2 = {{'h', 'i', 'j'}};
+	std::string data3 = "klmnopqrstuvwxyz";
+	size_t size = bencoded_size(
+			bdict(
+				k_v("a", "b"),
+				k_v("1", -2),
+				k_v("list", blist("a", "b", "c", "d", data1, data2, data3, 1234567890))
+				)
+			);
+	unsigned char* last = bencoder(output, 1024)(
+			bdict(
+				k_v("a", "b"),
+				k_v("1", -2),
+				k_v("list", blist("a", "b", "c", "d", data1, data2, data3, 1234567890))
+				)
+			);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	EXPECT_EQ(size_t(last - output), size);
+	EXPECT_EQ(0u, bencoded_size());
+	EXPECT_EQ(3u, bencoded_size(0));
+	EXPECT_EQ(4u, bencoded_size(-1));
+	EXPECT_EQ(22u, bencoded_size(UINT64_MAX));
+}
+
+#if __cplusplus >= 201402L
+TEST(ebb, bencoded_size_constexpr) {
+	typedef std::array<unsigned char, 20> node_id;
+	std::array<unsigned char, bencoded_size(
+			bdict(
+				k_v("a", bdict(k_v("id", node_id()))),
+				k_v("q", "ping"),
+				k_v("t", std::array<unsigned char, 2>()),
+				k_v("y", "q")
+				)
+			)> output;
+	static_assert(sizeof(output) == 56, "unexpected size of a ping query");
+	node_id id = {{0}};
+	std::array<unsigned char, 2> t = {{'a', 'a'}};
+	unsigned char* last = bencoder(output)(
+			bdict(
+				k_v("a", bdict(k_v("id", id))),
+				k_v("q", "ping"),
+				k_v("t", t),
+				k_v("y", "q")
+				)
+			);
+	EXPECT_EQ(output.data() + output.size(), last);
+}
+#endif
+
+TEST(ebb, needed) {
+	unsigned char output[8];
+	bencoder b(output, 8);
+	EXPECT_NE(static_cast<unsigned char*>(NULL), b(blist_begin, "ab"));
+	EXPECT_EQ(5u, b.needed());
+	EXPECT_EQ(static_cast<unsigned char*>(NULL), b("cdef", 12, blist_end));
+	EXPECT_EQ(16u, b.needed());
+}
+
+TEST(btemplate, ping) {
+	bslot<2> t;
+	bslot<20> id;
+	btemplate<64> ping;
+	ASSERT_TRUE(ping.compile(
+			bdict(
+				k_v("a", bdict(k_v("id", id))),
+				k_v("q", "ping"),
+				k_v("t", t),
+				k_v("y", "q")
+				)
+			));
+	EXPECT_EQ(56u, ping.size());
+	EXPECT_EQ(12u, id.offset);
+	EXPECT_EQ(47u, t.offset);
+
+	const char* expected = "d1:ad2:id20:abcdefghij0123456789e1:q4:ping1:t2:xy1:y1:qe";
+	std::array<unsigned char, 20> node_id;
+	std::memcpy(node_id.data(), "abcdefghij0123456789", 20);
+	std::array<unsigned char, 2> transaction = {{'x', 'y'}};
+	unsigned char output[1024];
+	unsigned char* last = ping(output, sizeof(output));
+	ASSERT_EQ(output + 56, last);
+	id.patch(output, node_id);
+	t.patch(output, transaction);
+	*last = '\0';
+	EXPECT_STREQ(expected, reinterpret_cast<const char*>(output));
+
+	EXPECT_EQ(static_cast<unsigned char*>(NULL), ping(output, 55));
+}
+
+TEST(btemplate, bounds) {
+	bslot<20> id;
+	btemplate<16> small;
+	EXPECT_FALSE(small.compile(bdict(k_v("id", id))));
+	EXPECT_EQ(0u, small.size());
+}
+
+TEST(ebb, map) {
+	unsigned char output[1024];
+	std::map<std::string, int> value;
+	value["b"] = 2;
+	value["a"] = 1;
+	value["aa"] = 3;
+	unsigned char* last = bencoder(output, 1024)(value);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	*last = '\0';
+	EXPECT_STREQ("d1:ai1e2:aai3e1:bi2ee", reinterpret_cast<const char*>(output));
+	EXPECT_EQ(size_t(last - output), bencoded_size(value));
+}
+
+TEST(ebb, unordered_map) {
+	std::vector<unsigned char> output(64 * 1024);
+	std::unordered_map<std::string, std::vector<std::string>> value;
+	std::map<std::string, std::vector<std::string>> sorted;
+	// too large to be sorted on the stack
+	for (int i = 0; i < 300; i++) {
+		std::string key(1, char('a' + i % 26));
+		key += std::to_string(i * 7919 % 1000);
+		value[key].push_back(key);
+		sorted[key].push_back(key);
+	}
+	value["\xff"].push_back("high bit");
+	sorted["\xff"].push_back("high bit");
+	unsigned char* last = bencoder(output.data(), output.size())(value);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	std::vector<unsigned char> expected(64 * 1024);
+	unsigned char* expected_last = bencoder(expected.data(), expected.size())(sorted);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), expected_last);
+	ASSERT_EQ(expected_last - expected.data(), last - output.data());
+	EXPECT_EQ(0, memcmp(expected.data(), output.data(), last - output.data()));
+	EXPECT_EQ(size_t(last - output.data()), bencoded_size(value));
+}
+
+TEST(ebb, large_unordered_map) {
+	const size_t n = 5000;
+	std::unordered_map<std::string, int> value;
+	std::map<std::string, int> sorted;
+	for (size_t i = 0; i < n; i++) {
+		std::string key = std::to_string(i * 7919 % 100000);
+		value[key] = int(i);
+		sorted[key] = int(i);
+	}
+	std::vector<unsigned char> expected(n * 32);
+	unsigned char* expected_last = bencoder(expected.data(), expected.size())(sorted);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), expected_last);
+	std::string expected_text(reinterpret_cast<char*>(expected.data()),
+			expected_last - expected.data());
+
+	std::vector<unsigned char> output(n * 32);
+	unsigned char* last = bencoder(output.data(), output.size())(value);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	EXPECT_EQ(expected_text, std::string(reinterpret_cast<char*>(output.data()),
+				last - output.data()));
+
+	// sorted in caller supplied scratch, or as before if it is too small
+	typedef std::unordered_map<std::string, int>::value_type entry;
+	std::vector<const entry*> scratch(n);
+	for (size_t capacity = n; capacity >= n - 1; capacity--) {
+		last = bencoder(output.data(), output.size())(
+				bsorted_map(value, scratch.data(), capacity));
+		ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+		EXPECT_EQ(expected_text, std::string(reinterpret_cast<char*>(output.data()),
+					last - output.data()));
+		EXPECT_EQ(size_t(last - output.data()),
+				bencoded_size(bsorted_map(value, scratch.data(), capacity)));
+	}
+}
+
+TEST(ebb, vector_of_values) {
+	unsigned char output[1024];
+	std::vector<int> numbers = {1, 2, 3};
+	std::vector<std::string> strings = {"ab", "c"};
+	std::vector<std::vector<int>> nested = {{1}, {}};
+	unsigned char* last = bencoder(output, 1024)(
+			blist(numbers, strings, nested)
+			);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	*last = '\0';
+	EXPECT_STREQ("lli1ei2ei3eel2:ab1:celli1eeleee",
+			reinterpret_cast<const char*>(output));
+}
+
+TEST(ebb, range) {
+	unsigned char output[1024];
+	const char* peers[] = {"abcdef", "ghijkl", "mnopqr"};
+	unsigned char* last = bencoder(output, 1024)(
+			bdict(k_v("values", brange(peers, peers + 2)))
+			);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	*last = '\0';
+	EXPECT_STREQ("d6:valuesl6:abcdef6:ghijklee",
+			reinterpret_cast<const char*>(output));
+	EXPECT_EQ(size_t(last - output),
+			bencoded_size(bdict(k_v("values", brange(peers, peers + 2)))));
+}
+
+TEST(ebb, optional) {
+	unsigned char output[1024];
+	std::array<unsigned char, 2> token = {{'t', 'k'}};
+	int port = 6881;
+	unsigned char* last = bencoder(output, 1024)(
+			bdict(
+				k_v("port", bopt(port, false)),
+				k_v("token", bopt(token, true)),
+				k_v("values", blist(bopt(&port), bopt<int>(NULL)))
+				)
+			);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	*last = '\0';
+	EXPECT_STREQ("d5:token2:tk6:valuesli6881eee", reinterpret_cast<const char*>(output));
+	EXPECT_EQ(size_t(last - output),
+			bencoded_size(
+				bdict(
+					k_v("port", bopt(port, false)),
+					k_v("token", bopt(token, true)),
+					k_v("values", blist(bopt(&port), bopt<int>(NULL)))
+					)
+				));
+}
+
+TEST(ebb, container_bounds) {
+	unsigned char output[8];
+	std::vector<int> numbers = {1, 2, 3};
+	EXPECT_EQ(static_cast<unsigned char*>(NULL), bencoder(output, 8)(numbers));
+	std::unordered_map<std::string, int> value;
+	value["abcdef"] = 1;
+	EXPECT_EQ(static_cast<unsigned char*>(NULL), bencoder(output, 8)(value));
+}
+
+#if __cplusplus >= 201703L
+TEST(ebb, std_optional) {
+	unsigned char output[1024];
+	std::optional<int> absent;
+	std::optional<std::string> present("x");
+	unsigned char* last = bencoder(output, 1024)(
+			bdict(
+				k_v("a", absent),
+				k_v("b", present)
+				)
+			);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	*last = '\0';
+	EXPECT_STREQ("d1:b1:xe", reinterpret_cast<const char*>(output));
+}
+#endif
+
+TEST(ebb, static_keys) {
+	unsigned char output[1024];
+	std::array<unsigned char, 2> t = {{'a', 'a'}};
+	unsigned char* last = bencoder(output, 1024)(
+			bdict(
+				k_v(EBB_KEY("q"), "ping"),
+				k_v(EBB_KEY("t"), t),
+				k_v(EBB_KEY("y"), "q")
+				)
+			);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	*last = '\0';
+	EXPECT_STREQ("d1:q4:ping1:t2:aa1:y1:qe", reinterpret_cast<const char*>(output));
+	EXPECT_EQ(size_t(last - output), bencoded_size(
+			bdict(
+				k_v(EBB_KEY("q"), "ping"),
+				k_v(EBB_KEY("t"), t),
+				k_v(EBB_KEY("y"), "q")
+				)
+			));
+
+	typedef decltype(EBB_KEY("a")) a;
+	typedef decltype(EBB_KEY("ab")) ab;
+	typedef decltype(EBB_KEY("b")) b;
+	typedef decltype(EBB_KEY("\xff")) high;
+	static_assert(detail::static_keys_ascending<a, ab, b, high>::value, "");
+	static_assert(!detail::static_keys_ascending<ab, a>::value, "");
+	static_assert(!detail::static_keys_ascending<a, a>::value, "");
+	// runtime keys are not checked, but do not break up the check either
+	static_assert(!detail::static_keys_ascending<b, const char*, a>::value, "");
+	static_assert(detail::static_keys_ascending<a, const char*, b>::value, "");
+	static_assert(!detail::static_keys_unique<a, b, a>::value, "");
+}
+
+TEST(ebb, sorted_dict_static) {
+	unsigned char output[1024];
+	unsigned char* last = bencoder(output, 1024)(
+			bsorted_dict(
+				k_v(EBB_KEY("y"), "q"),
+				k_v(EBB_KEY("announce-list"), blist()),
+				k_v(EBB_KEY("t"), "aa"),
+				k_v(EBB_KEY("announce"), 1),
+				k_v(EBB_KEY("q"), "ping")
+				)
+			);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	*last = '\0';
+	EXPECT_STREQ("d8:announcei1e13:announce-listle1:q4:ping1:t2:aa1:y1:qe",
+			reinterpret_cast<const char*>(output));
+}
+
+TEST(ebb, sorted_dict_runtime) {
+	unsigned char output[1024];
+	std::string name = "name";
+	unsigned char* last = bencoder(output, 1024)(
+			bsorted_dict(
+				k_v("piece length", 16384),
+				k_v(name, "x"),
+				k_v(EBB_KEY("length"), 3),
+				k_v("pieces", "")
+				)
+			);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	*last = '\0';
+	EXPECT_STREQ("d6:lengthi3e4:name1:x12:piece lengthi16384e6:pieces0:e",
+			reinterpret_cast<const char*>(output));
+
+	EXPECT_EQ(static_cast<unsigned char*>(NULL), bencoder(output, 1024)(
+			bsorted_dict(
+				k_v("b", 1),
+				k_v("a", 2),
+				k_v("b", 3)
+				)
+			));
+
+	// an absent optional entry is not written, so it is no duplicate either
+	std::string port = "port";
+	last = bencoder(output, 1024)(
+			bsorted_dict(
+				k_v(port, bopt(6881, false)),
+				k_v("port", 2)
+				)
+			);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	*last = '\0';
+	EXPECT_STREQ("d4:porti2ee", reinterpret_cast<const char*>(output));
+
+	// a duplicate key is no overflow, so no larger buffer is asked for
+	bencoder duplicate(output, 1024);
+	EXPECT_EQ(static_cast<unsigned char*>(NULL), duplicate(
+			bsorted_dict(
+				k_v(port, 1),
+				k_v("port", 2)
+				)
+			));
+	EXPECT_EQ(0u, duplicate.needed());
+}
@@ -0,0 +1,179 @@
+// Copyright (C) 2014 Igor Kaplounenko
+// Licensed under MIT License
+
+#include "ebb.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace ebb;
+
+namespace krpc {
+	typedef std::array<unsigned char, 20> node_id;
+
+	struct find_node_args {
+		node_id id;
+		node_id target;
+	};
+	EBB_FIELDS(find_node_args, target, id)
+
+	struct find_node {
+		std::string y;
+		bstring_view t;
+		std::string q;
+		find_node_args a;
+	};
+	EBB_FIELDS(find_node, y, t, q, a)
+
+	struct peer {
+		std::string ip;
+		std::uint16_t port;
+	};
+	EBB_FIELDS(peer, port, ip)
+
+	struct swarm {
+		std::vector<peer> peers;
+		std::int64_t interval;
+	};
+	EBB_FIELDS(swarm, peers, interval)
+}
+
+static const unsigned char* bytes(const char* s) {
+	return reinterpret_cast<const unsigned char*>(s);
+}
+
+static std::string as_string(const unsigned char* first, const unsigned char* last) {
+	return std::string(reinterpret_cast<const char*>(first), last - first);
+}
+
+static krpc::find_node make_query() {
+	krpc::find_node query;
+	query.y = "q";
+	query.t = bstring_view(bytes("aa"), 2);
+	query.q = "find_node";
+	query.a.id.fill('i');
+	query.a.target.fill('x');
+	return query;
+}
+
+static const char* query_bytes = "d1:ad2:id20:iiiiiiiiiiiiiiiiiiii6:target"
+	"20:xxxxxxxxxxxxxxxxxxxxe1:q9:find_node1:t2:aa1:y1:qe";
+
+TEST(bfields, encode) {
+	krpc::find_node query = make_query();
+	unsigned char output[256];
+	unsigned char* last = bencoder(output, sizeof(output))(bfields(query));
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	EXPECT_EQ(query_bytes, as_string(output, last));
+	// structs can also be passed as they are
+	last = bencoder(output, sizeof(output))(query);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	EXPECT_EQ(query_bytes, as_string(output, last));
+	EXPECT_EQ(strlen(query_bytes), bencoded_size(query));
+}
+
+TEST(bfields, decode) {
+	std::array<btoken, 32> tokens;
+	bdecoder decode(tokens);
+	ASSERT_NE(static_cast<const unsigned char*>(NULL),
+			decode(bytes(query_bytes), strlen(query_bytes)));
+	krpc::find_node query;
+	ASSERT_TRUE(bdecode(decode.root(), query));
+	EXPECT_EQ("q", query.y);
+	EXPECT_EQ("find_node", query.q);
+	EXPECT_TRUE(query.t == "aa");
+	// bstring_view members refer to the decoded buffer
+	EXPECT_EQ(bytes(query_bytes) + strlen(query_bytes) - 9, query.t.data());
+	krpc::find_node expected = make_query();
+	EXPECT_EQ(expected.a.id, query.a.id);
+	EXPECT_EQ(expected.a.target, query.a.target);
+}
+
+TEST(bfields, unknown_and_unsorted_keys) {
+	std::array<btoken, 32> tokens;
+	bdecoder decode(tokens);
+	const char* input = "d1:v4:LT011:yi1e4:porti6881e2:ip9:127.0.0.11:zle1:ali1eee";
+	ASSERT_NE(static_cast<const unsigned char*>(NULL), decode(bytes(input), strlen(input)));
+	krpc::peer p;
+	ASSERT_TRUE(bdecode(decode.root(), p));
+	EXPECT_EQ("127.0.0.1", p.ip);
+	EXPECT_EQ(6881, p.port);
+}
+
+TEST(bfields, missing_keys) {
+	std::array<btoken, 8> tokens;
+	bdecoder decode(tokens);
+	const char* input = "d4:porti1ee";
+	ASSERT_NE(static_cast<const unsigned char*>(NULL), decode(bytes(input), strlen(input)));
+	krpc::peer p = {"unchanged", 0};
+	ASSERT_TRUE(bdecode(decode.root(), p));
+	EXPECT_EQ("unchanged", p.ip);
+	EXPECT_EQ(1, p.port);
+}
+
+TEST(bfields, mismatches) {
+	std::array<btoken, 16> tokens;
+	bdecoder decode(tokens);
+	const char* inputs[] = {"d4:porti65536ee", "d4:porti-1ee", "d4:port1:1e",
+		"d2:ipi1ee", "l4:porti1ee", "d1:ad2:id3:abcee"};
+	for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+		const char* input = inputs[i];
+		ASSERT_NE(static_cast<const unsigned char*>(NULL),
+				decode(bytes(input), strlen(input))) << input;
+		krpc::peer p;
+		krpc::find_node query;
+		EXPECT_FALSE(i < 5 ? bdecode(decode.root(), p) : bdecode(decode.root(), query))
+			<< input;
+	}
+}
+
+TEST(bfields, vector_of_structs) {
+	krpc::swarm s;
+	s.interval = 1800;
+	krpc::peer a = {"10.0.0.1", 1};
+	krpc::peer b = {"10.0.0.2", 2};
+	s.peers.push_back(a);
+	s.peers.push_back(b);
+	unsigned char output[256];
+	unsigned char* last = bencoder(output, sizeof(output))(s);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	EXPECT_EQ("d8:intervali1800e5:peersld2:ip8:10.0.0.14:porti1eed2:ip8:10.0.0.2"
+			"4:porti2eeee", as_string(output, last));
+
+	std::array<btoken, 32> tokens;
+	bdecoder decode(tokens);
+	ASSERT_EQ(last, decode(output, last - output));
+	krpc::swarm copy;
+	ASSERT_TRUE(bdecode(decode.root(), copy));
+	EXPECT_EQ(1800, copy.interval);
+	ASSERT_EQ(2u, copy.peers.size());
+	EXPECT_EQ("10.0.0.2", copy.peers[1].ip);
+	EXPECT_EQ(2, copy.peers[1].port);
+}
+
+#if __cplusplus >= 201703L
+namespace krpc {
+	struct announce {
+		std::string info_hash;
+		std::optional<std::int64_t> port;
+	};
+	EBB_FIELDS(announce, info_hash, port)
+}
+
+TEST(bfields, std_optional) {
+	krpc::announce a = {"abc", std::nullopt};
+	unsigned char output[64];
+	unsigned char* last = bencoder(output, sizeof(output))(a);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	EXPECT_EQ("d9:info_hash3:abce", as_string(output, last));
+	a.port = 6881;
+	last = bencoder(output, sizeof(output))(a);
+	EXPECT_EQ("d9:info_hash3:abc4:porti6881ee", as_string(output, last));
+
+	std::array<btoken, 8> tokens;
+	bdecoder decode(tokens);
+	ASSERT_EQ(last, decode(output, last - output));
+	krpc::announce copy;
+	ASSERT_TRUE(bdecode(decode.root(), copy));
+	EXPECT_EQ(6881, *copy.port);
+}
+#endif
@@ -0,0 +1,120 @@
+// Copyright (C) 2014 Igor Kaplounenko
+// Licensed under MIT License
+
+#include "ebb.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace ebb;
+
+template<size_t N> static std::string hex(std::array<unsigned char, N> const& digest) {
+	static const char digits[] = "0123456789abcdef";
+	std::string result;
+	for (size_t i = 0; i < N; i++) {
+		result += digits[digest[i] >> 4];
+		result += digits[digest[i] & 0xf];
+	}
+	return result;
+}
+
+template<typename Hasher> static std::string hash(const std::string& input) {
+	Hasher hasher;
+	hasher.update(reinterpret_cast<const unsigned char*>(input.data()), input.size());
+	return hex(hasher.final());
+}
+
+TEST(bhash, sha1) {
+	EXPECT_EQ("da39a3ee5e6b4b0d3255bfef95601890afd80709", hash<sha1>(""));
+	EXPECT_EQ("a9993e364706816aba3e25717850c26c9cd0d89d", hash<sha1>("abc"));
+	EXPECT_EQ("84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+			hash<sha1>("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+	EXPECT_EQ("34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+			hash<sha1>(std::string(1000000, 'a')));
+}
+
+TEST(bhash, sha256) {
+	EXPECT_EQ("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+			hash<sha256>(""));
+	EXPECT_EQ("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+			hash<sha256>("abc"));
+	EXPECT_EQ("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+			hash<sha256>("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+	EXPECT_EQ("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+			hash<sha256>(std::string(1000000, 'a')));
+}
+
+TEST(bhash, incremental) {
+	std::string input(1000, 'x');
+	for (size_t i = 0; i < input.size(); i++) {
+		input[i] = char(i * 31);
+	}
+	// feed in uneven pieces to cross block boundaries at different offsets
+	sha1 hasher;
+	for (size_t i = 0, step = 1; i < input.size(); i += step, step = step % 97 + 13) {
+		size_t n = std::min(step, input.size() - i);
+		hasher.update(reinterpret_cast<const unsigned char*>(input.data()) + i, n);
+	}
+	EXPECT_EQ(hash<sha1>(input), hex(hasher.final()));
+}
+
+TEST(bhash, bencoder) {
+	unsigned char output[1024];
+	std::array<unsigned char, 20> pieces;
+	pieces.fill('p');
+	sha1 v1;
+	sha256 v2;
+	unsigned char* last = bencoder(output, 1024)(
+			bdict(
+				k_v("announce", "http://tracker/announce"),
+				k_v("info", bhashed(v1, bhashed(v2,
+						bdict(
+							k_v("length", 12345),
+							k_v("name", "file"),
+							k_v("piece length", 16384),
+							k_v("pieces", pieces)
+							)
+						)))
+				)
+			);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	std::array<btoken, 16> tokens;
+	bdecoder decode(tokens);
+	ASSERT_EQ(last, decode(output, last - output));
+	bstring_view info = decode.root().find("info").raw();
+	std::string info_bytes(reinterpret_cast<const char*>(info.data()), info.size());
+	EXPECT_EQ(hash<sha1>(info_bytes), hex(v1.final()));
+	EXPECT_EQ(hash<sha256>(info_bytes), hex(v2.final()));
+}
+
+TEST(bhash, sink) {
+	std::vector<unsigned char> pieces(100, 'p');
+	sha1 v1;
+	sha1 everything;
+	bhash_sink<sha1> sink(everything);
+	EXPECT_TRUE(bencode_to(sink,
+			bdict(
+				k_v("announce", "http://tracker/announce"),
+				k_v("info", bhashed(v1,
+						bdict(
+							k_v("length", 12345),
+							k_v("name", "file"),
+							k_v("pieces", pieces)
+							)
+						))
+				)
+			));
+	unsigned char output[1024];
+	unsigned char* last = bencoder(output, 1024)(
+			bdict(
+				k_v("length", 12345),
+				k_v("name", "file"),
+				k_v("pieces", pieces)
+				)
+			);
+	ASSERT_NE(static_cast<unsigned char*>(NULL), last);
+	EXPECT_EQ(hash<sha1>(std::string(reinterpret_cast<const char*>(output),
+					last - output)), hex(v1.final()));
+	std::string whole = "d8:announce23:http://tracker/announce4:info"
+		+ std::string(reinterpret_cast<const char*>(output), last - output) + "e";
+	EXPECT_EQ(hash<sha1>(whole), hex(everything.final()));
+}
@@ -0,0 +1,156 @@
+// Copyright (C) 2014 Igor Kaplounenko
+// Licensed under MIT License
+
+#include "ebb.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace ebb;
+
+static const unsigned char* bytes(const char* s) {
+	return reinterpret_cast<const unsigned char*>(s);
+}
+
+// records events as text, joining the pieces of each string
+struct recorder {
+	std::string events;
+	bool in_string = false;
+
+	void begin_dict() { events += "d "; }
+	void begin_list() { events += "l "; }
+	void end() { events += "e "; }
+	void integer(std::int64_t value) { events += "i" + std::to_string(value) + " "; }
+	void key(const unsigned char* data, size_t size, size_t remaining) {
+		piece("k:", data, size, remaining);
+	}
+	void string(const unsigned char* data, size_t size, size_t remaining) {
+		piece("s:", data, size, remaining);
+	}
+	void piece(const char* kind, const unsigned char* data, size_t size,
+			size_t remaining) {
+		if (!in_string) {
+			events += kind;
+		}
+		events.append(reinterpret_cast<const char*>(data), size);
+		in_string = remaining != 0;
+		if (!in_string) {
+			events += " ";
+		}
+	}
+};
+
+static const char* krpc = "d1:ad2:id20:abcdefghij01234567896:target"
+	"20:mnopqrstuvwxyz123456e1:q9:find_node1:t2:aa1:y1:qe";
+
+TEST(bparser, whole_message) {
+	recorder r;
+	bparser<recorder> parse(r);
+	ASSERT_EQ(strlen(krpc), parse.feed(bytes(krpc), strlen(krpc)));
+	ASSERT_TRUE(parse.done());
+	EXPECT_EQ("d k:a d k:id s:abcdefghij0123456789 k:target s:mnopqrstuvwxyz123456 "
+			"e k:q s:find_node k:t s:aa k:y s:q e ", r.events);
+}
+
+TEST(bparser, any_fragmentation) {
+	recorder whole;
+	bparser<recorder> reference(whole);
+	reference.feed(bytes(krpc), strlen(krpc));
+	for (size_t step = 1; step <= 7; step++) {
+		recorder r;
+		bparser<recorder> parse(r);
+		size_t total = 0;
+		for (size_t at = 0; at < strlen(krpc); at += step) {
+			size_t n = std::min(step, strlen(krpc) - at);
+			ASSERT_FALSE(parse.done());
+			ASSERT_EQ(n, parse.feed(bytes(krpc) + at, n));
+			total += n;
+		}
+		EXPECT_EQ(strlen(krpc), total);
+		EXPECT_TRUE(parse.done());
+		EXPECT_EQ(whole.events, r.events) << "step " << step;
+	}
+}
+
+struct piece_counter {
+	size_t pieces = 0;
+	size_t last_remaining = 0;
+	std::string data;
+
+	void begin_dict() {}
+	void begin_list() {}
+	void end() {}
+	void integer(std::int64_t) {}
+	void key(const unsigned char*, size_t, size_t) {}
+	void string(const unsigned char* p, size_t size, size_t remaining) {
+		pieces++;
+		last_remaining = remaining;
+		data.append(reinterpret_cast<const char*>(p), size);
+	}
+};
+
+TEST(bparser, long_string_in_pieces) {
+	piece_counter c;
+	bparser<piece_counter> parse(c);
+	std::string payload(1000, 'x');
+	std::string input = "1000:" + payload;
+	EXPECT_EQ(300u, parse.feed(bytes(input.c_str()), 300));
+	EXPECT_EQ(1u, c.pieces);
+	EXPECT_EQ(705u, c.last_remaining);
+	EXPECT_EQ(input.size() - 300, parse.feed(bytes(input.c_str()) + 300,
+				input.size() - 300));
+	EXPECT_EQ(2u, c.pieces);
+	EXPECT_EQ(0u, c.last_remaining);
+	EXPECT_EQ(payload, c.data);
+	EXPECT_TRUE(parse.done());
+}
+
+TEST(bparser, stops_after_value) {
+	recorder r;
+	bparser<recorder> parse(r);
+	const char* input = "li1ei-2e0:ePAYLOAD";
+	EXPECT_EQ(11u, parse.feed(bytes(input), strlen(input)));
+	EXPECT_TRUE(parse.done());
+	EXPECT_EQ("l i1 i-2 s: e ", r.events);
+	EXPECT_EQ(0u, parse.feed(bytes(input) + 11, strlen(input) - 11));
+	parse.reset();
+	r.events.clear();
+	const char* next = "i42e";
+	EXPECT_EQ(4u, parse.feed(bytes(next), 4));
+	EXPECT_TRUE(parse.done());
+	EXPECT_EQ("i42 ", r.events);
+}
+
+TEST(bparser, integer_limits) {
+	recorder r;
+	bparser<recorder> parse(r);
+	const char* min = "i-9223372036854775808e";
+	parse.feed(bytes(min), strlen(min));
+	EXPECT_TRUE(parse.done());
+	EXPECT_EQ("i-9223372036854775808 ", r.events);
+	parse.reset();
+	const char* overflow = "i9223372036854775808e";
+	parse.feed(bytes(overflow), strlen(overflow));
+	EXPECT_TRUE(parse.failed());
+}
+
+TEST(bparser, malformed) {
+	const char* inputs[] = {"ie", "i-e", "i--1e", "i1-e", "x", "e", "01:a",
+		"di1ei2ee", "d1:ae", "1a", "l1:ax"};
+	for (const char* input : inputs) {
+		recorder r;
+		bparser<recorder> parse(r);
+		parse.feed(bytes(input), strlen(input));
+		EXPECT_TRUE(parse.failed()) << input;
+		EXPECT_FALSE(parse.done()) << input;
+	}
+}
+
+TEST(bparser, depth_limit) {
+	recorder r;
+	bparser<recorder, 2> shallow(r);
+	shallow.feed(bytes("llee"), 4);
+	EXPECT_TRUE(shallow.done());
+	bparser<recorder, 2> deep(r);
+	EXPECT_EQ(2u, deep.feed(bytes("llleee"), 6));
+	EXPECT_TRUE(deep.failed());
+}
@@ -0,0 +1,156 @@
+// Copyright (C) 2014 Igor Kaplounenko
+// Licensed under MIT License
+
+#include "ebb.hpp"
+
+#include "gtest/gtest.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace ebb;
+
+static const char* expected = "d1:a1:b1:1i2e4:listl1:a1:b1:c1:d3:efg3:hijee";
+
+struct string_appender {
+	std::string* output;
+	bool operator()(const unsigned char* data, size_t size) {
+		output->append(reinterpret_cast<const char*>(data), size);
+		return true;
+	}
+};
+
+TEST(bsinks, callback) {
+	std::string output;
+	string_appender appender = {&output};
+	bcallback_sink<string_appender> sink(appender);
+	std::array<unsigned char, 3> data1 = {{'e', 'f', 'g'}};
+	std::vector<unsigned char> data2 = {{'h', 'i', 'j'}};
+	bool ok = bencode_to(sink,
+			bdict(
+				k_v("a", "b"),
+				k_v("1", 2),
+				k_v("list", blist("a", "b", "c", "d", data1, data2))
+				)
+			);
+	EXPECT_TRUE(ok);
+	EXPECT_EQ(expected, output);
+}
+
+TEST(bsinks, resumable) {
+	std::string output;
+	string_appender appender = {&output};
+	bcallback_sink<string_appender> sink(appender);
+	bsink_encoder<bcallback_sink<string_appender>> encode(sink);
+	EXPECT_TRUE(encode(blist_begin, "abc"));
+	EXPECT_TRUE(encode("def", blist_end));
+	EXPECT_EQ("l3:abc3:defe", output);
+}
+
+struct chunk_pool {
+	std::array<std::array<unsigned char, 8>, 8>* storage;
+	std::array<bchunk, 8>* chunks;
+	size_t used;
+	bchunk* operator()() {
+		if (used == chunks->size()) {
+			return NULL;
+		}
+		bchunk* chunk = &(*chunks)[used];
+		chunk->data = (*storage)[used].data();
+		chunk->capacity = (*storage)[used].size();
+		used++;
+		return chunk;
+	}
+};
+
+TEST(bsinks, chunks) {
+	std::array<std::array<unsigned char, 8>, 8> storage;
+	std::array<bchunk, 8> chunks;
+	chunk_pool pool = {&storage, &chunks, 0};
+	bchunk_sink<chunk_pool> sink(pool);
+	std::array<unsigned char, 3> data1 = {{'e', 'f', 'g'}};
+	std::vector<unsigned char> data2 = {{'h', 'i', 'j'}};
+	bool ok = bencode_to(sink,
+			bdict(
+				k_v("a", "b"),
+				k_v("1", 2),
+				k_v("list", blist("a", "b", "c", "d", data1, data2))
+				)
+			);
+	ASSERT_TRUE(ok);
+	std::string output;
+	size_t n = 0;
+	for (bchunk* chunk = sink.chain(); chunk; chunk = chunk->next, n++) {
+		EXPECT_TRUE(chunk->size == 8 || !chunk->next);
+		output.append(reinterpret_cast<const char*>(chunk->data), chunk->size);
+	}
+	EXPECT_EQ(6u, n);
+	EXPECT_EQ(expected, output);
+}
+
+TEST(bsinks, chunks_exhausted) {
+	std::array<std::array<unsigned char, 8>, 8> storage;
+	std::array<bchunk, 8> chunks;
+	chunk_pool pool = {&storage, &chunks, 0};
+	bchunk_sink<chunk_pool> sink(pool);
+	std::vector<unsigned char> large(100, 'x');
+	EXPECT_FALSE(bencode_to(sink, large));
+}
+
+#ifndef _WIN32
+TEST(bsinks, iovec) {
+	std::array<struct iovec, 8> iov;
+	std::array<unsigned char, 64> scratch;
+	biovec_sink sink(iov.data(), iov.size(), scratch.data(), scratch.size(), 16);
+	std::vector<unsigned char> piece(100, 'x');
+	bool ok = bencode_to(sink,
+			bdict(
+				k_v("msg_type", 1),
+				k_v("piece", 0),
+				k_v("data", piece)
+				)
+			);
+	ASSERT_TRUE(ok);
+	// everything before the payload is coalesced into one entry, the payload is
+	// referenced rather than copied
+	ASSERT_EQ(3u, sink.size());
+	EXPECT_EQ(piece.data(), sink.data()[1].iov_base);
+	EXPECT_EQ(piece.size(), sink.data()[1].iov_len);
+	std::string output;
+	for (size_t i = 0; i < sink.size(); i++) {
+		output.append(static_cast<const char*>(sink.data()[i].iov_base),
+				sink.data()[i].iov_len);
+	}
+	EXPECT_EQ("d8:msg_typei1e5:piecei0e4:data100:" + std::string(100, 'x') + "e",
+			output);
+}
+
+TEST(bsinks, iovec_bounds) {
+	std::array<struct iovec, 1> iov;
+	std::array<unsigned char, 64> scratch;
+	biovec_sink sink(iov.data(), iov.size(), scratch.data(), scratch.size(), 16);
+	std::vector<unsigned char> piece(100, 'x');
+	EXPECT_FALSE(bencode_to(sink, blist(piece)));
+}
+
+TEST(bsinks, fd) {
+	int fds[2];
+	ASSERT_EQ(0, pipe(fds));
+	std::array<unsigned char, 16> staging;
+	bfd_sink sink(fds[1], staging);
+	std::vector<unsigned char> large(40, 'x');
+	EXPECT_TRUE(bencode_to(sink, blist("abc", 42, large)));
+	EXPECT_TRUE(sink.flush());
+	close(fds[1]);
+	std::string output;
+	char buffer[256];
+	ssize_t n;
+	while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) {
+		output.append(buffer, n);
+	}
+	close(fds[0]);
+	EXPECT_EQ("l3:abci42e40:" + std::string(40, 'x') + "e", output);
+}
+#endif
@@ -0,0 +1,209 @@
+// Copyright (C) 2014 Igor Kaplounenko
+// Licensed under MIT License
+
+#include "ebb.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+#include "gtest/gtest.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace ebb;
+
+struct torrent_file {
+	std::int64_t length;
+	std::vector<std::string> path;
+};
+EBB_FIELDS(torrent_file, length, path)
+
+static const unsigned char* bytes(const char* s) {
+	return reinterpret_cast<const unsigned char*>(s);
+}
+
+static std::vector<unsigned char> make_torrent(size_t files, size_t pieces) {
+	std::vector<unsigned char> hashes(pieces * 20);
+	for (size_t i = 0; i < hashes.size(); i++) {
+		hashes[i] = static_cast<unsigned char>(i / 20);
+	}
+	std::vector<unsigned char> output(files * 64 + pieces * 20 + 1024);
+	std::vector<torrent_file> file_list(files);
+	for (size_t i = 0; i < files; i++) {
+		file_list[i].length = std::int64_t(i + 1);
+		file_list[i].path = {"dir", "file" + std::to_string(i)};
+	}
+	unsigned char* last = bencoder(output.data(), output.size())(
+			bdict(
+				k_v("announce", "http://tracker/announce"),
+				k_v("comment", "lazy"),
+				k_v("info", bdict(
+						k_v("files", file_list),
+						k_v("name", "example"),
+						k_v("piece length", 16384),
+						k_v("pieces", hashes)
+						))
+				)
+			);
+	output.resize(last - output.data());
+	return output;
+}
+
+TEST(blazy, lookups) {
+	const char* input = "d1:ai-5e1:bl1:x1:y1:ze1:cd1:di1eee";
+	blazy root(bytes(input), strlen(input));
+	ASSERT_TRUE(root.is_dict());
+	EXPECT_EQ(3u, root.size());
+	EXPECT_EQ(-5, root.find("a").integer());
+	blazy list = root.find("b");
+	ASSERT_TRUE(list.is_list());
+	EXPECT_EQ(3u, list.size());
+	EXPECT_TRUE(list[2].string() == "z");
+	EXPECT_FALSE(list[3]);
+	EXPECT_EQ(1, root.find("c").find("d").integer());
+	EXPECT_TRUE(root.find("c").raw() == "d1:di1ee");
+	EXPECT_FALSE(root.find("bb"));
+	EXPECT_FALSE(root.find("0"));
+	EXPECT_FALSE(root.find("z"));
+}
+
+TEST(blazy, missing_and_mistyped) {
+	const char* input = "d1:ai-5e1:bl1:xe1:c3:abce";
+	blazy root(bytes(input), strlen(input));
+
+	// missing keys chain into empty views
+	blazy missing = root.find("r").find("port");
+	EXPECT_FALSE(missing);
+	EXPECT_EQ(0, missing.integer());
+	EXPECT_TRUE(missing.string().empty());
+	EXPECT_TRUE(missing.raw().empty());
+	EXPECT_EQ(0u, missing.size());
+	EXPECT_TRUE(missing.begin() == missing.end());
+	EXPECT_FALSE(missing[0]);
+	EXPECT_FALSE(missing.find("port"));
+
+	// so do lookups into values of the wrong type
+	EXPECT_FALSE(root.find("a").find("x"));
+	EXPECT_FALSE(root.find("c")[0]);
+	EXPECT_FALSE(root.find("b").find("x"));
+	EXPECT_FALSE(root[0]);
+	EXPECT_EQ(0, root.find("c").integer());
+	EXPECT_TRUE(root.find("a").string().empty());
+	EXPECT_EQ(0u, root.find("c").size());
+	EXPECT_TRUE(root.find("c").begin() == root.find("c").end());
+	EXPECT_TRUE(root.find("b")[0].string() == "x");
+}
+
+TEST(blazy, stops_at_greater_key) {
+	// not canonical: "a" comes after "b", so it is not found
+	const char* input = "d1:bi1e1:ai2ee";
+	blazy root(bytes(input), strlen(input));
+	EXPECT_EQ(1, root.find("b").integer());
+	EXPECT_FALSE(root.find("a"));
+}
+
+TEST(blazy, malformed) {
+	const char* inputs[] = {"d1:ai1e", "d1:a", "l5:abce", "i12"};
+	for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+		blazy v(bytes(inputs[i]), strlen(inputs[i]));
+		EXPECT_TRUE(v.raw().empty()) << inputs[i];
+		if (v.is_dict()) {
+			EXPECT_FALSE(v.find("b")) << inputs[i];
+		}
+	}
+	// a key without a value
+	const char* unpaired = "d3:abce";
+	EXPECT_FALSE(blazy(bytes(unpaired), strlen(unpaired)).find("abc"));
+	EXPECT_FALSE(blazy());
+	EXPECT_FALSE(blazy(bytes(""), 0));
+}
+
+TEST(btorrent, in_memory) {
+	std::vector<unsigned char> data = make_torrent(3, 10);
+	btorrent torrent(data.data(), data.size());
+	EXPECT_TRUE(torrent.name() == "example");
+	ASSERT_EQ(10u, torrent.piece_count());
+	bstring_view piece = torrent.piece(7);
+	ASSERT_EQ(20u, piece.size());
+	EXPECT_EQ(7, piece[0]);
+	EXPECT_GT(piece.data(), data.data());
+	EXPECT_LT(piece.data(), data.data() + data.size());
+	EXPECT_TRUE(torrent.piece(10).empty());
+	ASSERT_EQ(3u, torrent.file_count());
+	EXPECT_EQ(3, torrent.file(2).find("length").integer());
+	EXPECT_TRUE(torrent.file(1).find("path")[1].string() == "file1");
+	EXPECT_FALSE(torrent.file(3));
+	EXPECT_EQ(0, torrent.file(7).find("length").integer());
+
+	std::array<btoken, 64> tokens;
+	bdecoder decode(tokens);
+	ASSERT_NE(static_cast<const unsigned char*>(NULL), decode(data.data(), data.size()));
+	bstring_view info = decode.root().find("info").raw();
+	sha1 expected;
+	expected.update(info.data(), info.size());
+	std::array<unsigned char, 20> hash;
+	ASSERT_TRUE(torrent.info_hash(hash));
+	EXPECT_EQ(expected.final(), hash);
+}
+
+TEST(btorrent, single_file_and_garbage) {
+	const char* single = "d4:infod6:lengthi5e4:name1:x6:pieces20:01234567890123456789ee";
+	btorrent torrent(bytes(single), strlen(single));
+	EXPECT_EQ(0u, torrent.file_count());
+	EXPECT_EQ(1u, torrent.piece_count());
+	EXPECT_TRUE(torrent.name() == "x");
+
+	const char* garbage = "li1ee";
+	btorrent other(bytes(garbage), strlen(garbage));
+	EXPECT_FALSE(other.info());
+	EXPECT_TRUE(other.name().empty());
+	EXPECT_EQ(0u, other.piece_count());
+	EXPECT_EQ(0u, other.file_count());
+	EXPECT_TRUE(other.info("name").string().empty());
+	EXPECT_FALSE(other.file(0).find("path")[0]);
+	std::array<unsigned char, 20> hash;
+	hash.fill(7);
+	EXPECT_FALSE(other.info_hash(hash));
+	EXPECT_EQ(7, hash[19]);
+}
+
+#ifndef _WIN32
+TEST(btorrent, mapped_file) {
+	std::vector<unsigned char> data = make_torrent(100, 1000);
+	char path[] = "/tmp/ebb-torrent-XXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_LE(0, fd);
+	ASSERT_EQ(ssize_t(data.size()), write(fd, data.data(), data.size()));
+	::close(fd);
+
+	btorrent torrent;
+	ASSERT_TRUE(torrent.open(path));
+	EXPECT_TRUE(torrent.name() == "example");
+	EXPECT_EQ(1000u, torrent.piece_count());
+	EXPECT_EQ(static_cast<unsigned char>(999), torrent.piece(999)[0]);
+	EXPECT_EQ(100u, torrent.file_count());
+	EXPECT_EQ(100, torrent.file(99).find("length").integer());
+	torrent.close();
+	EXPECT_EQ(0u, torrent.piece_count());
+	std::remove(path);
+
+	EXPECT_FALSE(torrent.open(path));
+	EXPECT_EQ(ENOENT, errno);
+}
+#endif
+
+TEST(btorrent, many_info_keys) {
+	std::string input = "d4:infod";
+	for (char c = 'a'; c <= 'z'; c++) {
+		input += std::string("1:") + c + "i" + std::to_string(c - 'a') + "e";
+	}
+	input += "ee";
+	btorrent torrent(bytes(input.c_str()), input.size());
+	EXPECT_EQ(0, torrent.info("a").integer());
+	EXPECT_EQ(15, torrent.info("p").integer());
+	EXPECT_EQ(25, torrent.info("z").integer());
+	EXPECT_FALSE(torrent.info("zz"));
+}
@@ -0,0 +1,175 @@
+// Copyright (C) 2014 Igor Kaplounenko
+// Licensed under MIT License
+
+#include "ebb.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace ebb;
+
+static const unsigned char* bytes(const char* s) {
+	return reinterpret_cast<const unsigned char*>(s);
+}
+
+static std::string encode(bvalue const& value) {
+	unsigned char output[1024];
+	unsigned char* last = bencoder(output, sizeof(output))(value);
+	EXPECT_NE(static_cast<unsigned char*>(NULL), last);
+	EXPECT_EQ(size_t(last - output), bencoded_size(value));
+	return std::string(reinterpret_cast<const char*>(output), last - output);
+}
+
+static const char* torrent = "d8:announce14:http://a/track13:announce-listll14:"
+	"http://a/trackel14:http://b/trackee4:infod6:lengthi1024e4:name5:a.txt"
+	"12:piece lengthi16384e6:pieces20:aaaaaaaaaaaaaaaaaaaa7:privatei1eee";
+
+TEST(bvalue, load_and_reencode) {
+	std::array<btoken, 64> tokens;
+	bdecoder decode(tokens);
+	ASSERT_NE(static_cast<const unsigned char*>(NULL),
+			decode(bytes(torrent), strlen(torrent)));
+	std::array<unsigned char, 2048> buffer;
+	barena arena(buffer);
+	bvalue root;
+	ASSERT_TRUE(root.load(arena, decode.root()));
+	EXPECT_EQ(torrent, encode(root));
+	// strings are not copied
+	EXPECT_EQ(bytes(torrent) + 14, root.find("announce")->string().data());
+}
+
+TEST(bvalue, edit_torrent) {
+	std::array<btoken, 64> tokens;
+	bdecoder decode(tokens);
+	ASSERT_NE(static_cast<const unsigned char*>(NULL),
+			decode(bytes(torrent), strlen(torrent)));
+	std::array<unsigned char, 2048> buffer;
+	barena arena(buffer);
+	bvalue root;
+	ASSERT_TRUE(root.load(arena, decode.root()));
+
+	EXPECT_TRUE(root.find("info")->erase("private"));
+	EXPECT_FALSE(root.find("info")->erase("private"));
+	bvalue* tiers = root.find("announce-list");
+	tiers->erase(0);
+	bvalue tier(btype::list);
+	ASSERT_TRUE(tier.push_back(arena, bvalue("http://c/track")));
+	ASSERT_TRUE(tiers->push_back(arena, tier));
+	ASSERT_TRUE(root.find("announce")->assign(arena, root.find("announce-list")
+				->begin()->begin()->string()));
+	bvalue* seeds = root.set(arena, "url-list", bvalue(btype::list));
+	ASSERT_NE(static_cast<bvalue*>(NULL), seeds);
+	ASSERT_TRUE(seeds->push_back(arena, bvalue("http://w/a.txt")));
+	ASSERT_NE(static_cast<bvalue*>(NULL), root.set(arena, "comment", bvalue("x")));
+
+	EXPECT_EQ("d8:announce14:http://b/track13:announce-listll14:http://b/track"
+			"el14:http://c/trackee7:comment1:x4:infod6:lengthi1024e4:name5:a.txt"
+			"12:piece lengthi16384e6:pieces20:aaaaaaaaaaaaaaaaaaaae"
+			"8:url-listl14:http://w/a.txtee", encode(root));
+	// the announce URL was copied into the arena
+	EXPECT_NE(bytes(torrent) + 14, root.find("announce")->string().data());
+}
+
+TEST(bvalue, build) {
+	std::array<unsigned char, 4096> buffer;
+	barena arena(buffer);
+	bvalue dict;
+	for (int i = 9; i >= 0; i--) {
+		char key[] = {char('a' + i), '\0'};
+		ASSERT_NE(static_cast<bvalue*>(NULL), dict.set(arena, key, bvalue(i)));
+	}
+	ASSERT_NE(static_cast<bvalue*>(NULL), dict.set(arena, "c", bvalue(-3)));
+	EXPECT_EQ(10u, dict.size());
+	EXPECT_EQ(-3, dict.find("c")->integer());
+	EXPECT_EQ(static_cast<bvalue*>(NULL), dict.find("z"));
+	EXPECT_EQ("d1:ai0e1:bi1e1:ci-3e1:di3e1:ei4e1:fi5e1:gi6e1:hi7e1:ii8e1:ji9ee",
+			encode(dict));
+	EXPECT_EQ("le", encode(bvalue(btype::list)));
+	EXPECT_EQ("i0e", encode(bvalue(btype::integer)));
+	EXPECT_EQ("0:", encode(bvalue(btype::string)));
+}
+
+TEST(bvalue, integer_range) {
+	EXPECT_EQ("i18446744073709551615e", encode(bvalue(UINT64_MAX)));
+	EXPECT_EQ("i9223372036854775808e",
+			encode(bvalue(std::uint64_t(INT64_MAX) + 1)));
+	EXPECT_EQ("i9223372036854775807e", encode(bvalue(INT64_MAX)));
+	EXPECT_EQ("i-9223372036854775808e", encode(bvalue(INT64_MIN)));
+	bvalue large(UINT64_MAX);
+	EXPECT_FALSE(large.is_int64());
+	EXPECT_EQ(UINT64_MAX, large.uinteger());
+	bvalue small(std::uint64_t(42));
+	EXPECT_TRUE(small.is_int64());
+	EXPECT_EQ(42, small.integer());
+	EXPECT_EQ(42u, small.uinteger());
+	EXPECT_TRUE(bvalue(-1).is_int64());
+}
+
+TEST(bvalue, literal_zero) {
+	std::array<unsigned char, 512> buffer;
+	barena arena(buffer);
+	EXPECT_EQ("i0e", encode(bvalue(0)));
+	EXPECT_EQ("i7e", encode(bvalue(7u)));
+	bvalue list(btype::list);
+	for (int i = 0; i < 3; i++) {
+		ASSERT_TRUE(list.push_back(arena, bvalue(i)));
+	}
+	list.erase(0);
+	EXPECT_EQ("li1ei2ee", encode(list));
+	list.erase(size_t(1));
+	EXPECT_EQ("li1ee", encode(list));
+}
+
+TEST(bvalue, arena_exhaustion) {
+	std::array<btoken, 64> tokens;
+	bdecoder decode(tokens);
+	ASSERT_NE(static_cast<const unsigned char*>(NULL),
+			decode(bytes(torrent), strlen(torrent)));
+	std::array<unsigned char, 128> buffer;
+	barena arena(buffer);
+	bvalue root;
+	EXPECT_FALSE(root.load(arena, decode.root()));
+	arena.reset();
+	EXPECT_EQ(0u, arena.size());
+	bvalue list(btype::list);
+	size_t pushed = 0;
+	while (list.push_back(arena, bvalue(std::int64_t(1)))) {
+		pushed++;
+	}
+	EXPECT_LT(0u, pushed);
+	EXPECT_EQ(pushed, list.size());
+}
+
+TEST(bvalue, depth_limit) {
+	std::array<btoken, 16> tokens;
+	bdecoder decode(tokens);
+	const char* input = "lllleeee";
+	ASSERT_NE(static_cast<const unsigned char*>(NULL), decode(bytes(input), strlen(input)));
+	std::array<unsigned char, 1024> buffer;
+	barena arena(buffer);
+	bvalue root;
+	EXPECT_FALSE(root.load(arena, decode.root(), 3));
+	EXPECT_TRUE(root.load(arena, decode.root(), 4));
+	EXPECT_EQ(input, encode(root));
+}
+
+// any type with allocate() can stand in for barena, e.g. a per-thread pool
+struct counting_arena {
+	barena arena;
+	size_t allocations;
+
+	void* allocate(size_t size, size_t alignment) {
+		allocations++;
+		return arena.allocate(size, alignment);
+	}
+};
+
+TEST(bvalue, custom_arena) {
+	std::array<unsigned char, 512> buffer;
+	counting_arena arena = {barena(buffer), 0};
+	bvalue list(btype::list);
+	for (int i = 0; i < 5; i++) {
+		ASSERT_TRUE(list.push_back(arena, bvalue(std::int64_t(i))));
+	}
+	EXPECT_EQ(2u, arena.allocations);
+	EXPECT_EQ("li0ei1ei2ei3ei4ee", encode(list));
+}